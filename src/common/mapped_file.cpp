@@ -0,0 +1,123 @@
+#include "mapped_file.h"
+#include <fstream>
+#include <cstdio>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define HAS_MMAP 1
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() : base(nullptr), length(0), writable(false) {}
+
+MappedFile::~MappedFile() {
+#ifdef HAS_MMAP
+    if (base != nullptr && fallback.empty()) {
+        munmap(const_cast<uint8_t*>(base), length);
+    }
+#else
+    if (writable) {
+        std::ofstream out(fallback_path, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(fallback.data()), fallback.size());
+    }
+#endif
+}
+
+std::shared_ptr<MappedFile> MappedFile::open(const std::string& path) {
+    std::shared_ptr<MappedFile> file(new MappedFile());
+
+#ifdef HAS_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return nullptr;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        return nullptr;
+    }
+
+    file->length = static_cast<size_t>(info.st_size);
+    if (file->length > 0) {
+        void* mapped = mmap(nullptr, file->length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED) {
+            ::close(fd);
+            return nullptr;
+        }
+        file->base = static_cast<const uint8_t*>(mapped);
+    }
+    // Отображение остается действительным и после закрытия дескриптора
+    ::close(fd);
+#else
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in.is_open()) return nullptr;
+    file->length = static_cast<size_t>(in.tellg());
+    file->fallback.resize(file->length);
+    in.seekg(0);
+    in.read(reinterpret_cast<char*>(file->fallback.data()), file->length);
+    file->base = file->fallback.data();
+#endif
+
+    return file;
+}
+
+std::shared_ptr<MappedFile> MappedFile::create(const std::string& path, size_t size) {
+    std::shared_ptr<MappedFile> file(new MappedFile());
+    file->writable = true;
+    file->length = size;
+
+#ifdef HAS_MMAP
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return nullptr;
+    if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+        ::close(fd);
+        return nullptr;
+    }
+    if (size > 0) {
+        void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mapped == MAP_FAILED) {
+            ::close(fd);
+            return nullptr;
+        }
+        file->base = static_cast<const uint8_t*>(mapped);
+    }
+    ::close(fd);
+#else
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) return nullptr;
+    file->fallback.resize(size);
+    file->fallback_path = path;
+    file->base = file->fallback.data();
+#endif
+
+    return file;
+}
+
+bool MappedFile::replace(const std::string& temp_path, const std::string& path) {
+#ifndef HAS_MMAP
+    // rename не заменяет существующий файл на всех платформах
+    std::remove(path.c_str());
+#endif
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        std::remove(temp_path.c_str());
+        return false;
+    }
+    return true;
+}
+
+void MappedFile::adviseSequential() const {
+#ifdef HAS_MMAP
+    if (base != nullptr && fallback.empty()) {
+        madvise(const_cast<uint8_t*>(base), length, MADV_SEQUENTIAL);
+    }
+#endif
+}
+
+void MappedFile::adviseRandom() const {
+#ifdef HAS_MMAP
+    if (base != nullptr && fallback.empty()) {
+        madvise(const_cast<uint8_t*>(base), length, MADV_RANDOM);
+    }
+#endif
+}
@@ -0,0 +1,51 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Файл, отображенный в память (mmap): для чтения (open) или для записи
+// (create). Объект разделяется через shared_ptr: представления данных
+// файла удерживают его, пока используются.
+class MappedFile {
+private:
+    const uint8_t* base;
+    size_t length;
+    bool writable;
+    std::vector<uint8_t> fallback;  // платформы без mmap: файл читается целиком
+    std::string fallback_path;      // и для записи сохраняется при разрушении
+
+    MappedFile();
+
+public:
+    ~MappedFile();
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // nullptr, если файл не удалось открыть или отобразить
+    static std::shared_ptr<MappedFile> open(const std::string& path);
+
+    // Новый файл заданного размера, отображенный для записи (MAP_SHARED:
+    // записанное попадает в файл). Существующий файл перезаписывается.
+    static std::shared_ptr<MappedFile> create(const std::string& path, size_t size);
+
+    // Замена файла path готовым файлом temp_path переименованием. Файл,
+    // уже отображенный читателями, не перезаписывается на месте (иначе
+    // чтение усеченного отображения дает SIGBUS): их отображения продолжают
+    // ссылаться на старое содержимое. При ошибке temp_path удаляется.
+    static bool replace(const std::string& temp_path, const std::string& path);
+
+    const uint8_t* data() const { return base; }
+    // nullptr для файла, открытого только для чтения
+    uint8_t* mutableData() { return writable ? const_cast<uint8_t*>(base) : nullptr; }
+    size_t size() const { return length; }
+
+    // Подсказки ядру о характере доступа (madvise); на других платформах - no-op
+    void adviseSequential() const;
+    void adviseRandom() const;
+};
+
+#endif
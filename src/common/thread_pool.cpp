@@ -0,0 +1,175 @@
+#include "thread_pool.h"
+#include <exception>
+#include <algorithm>
+
+namespace {
+
+// Пул и номер рабочего потока, которому принадлежит текущий поток
+thread_local const ThreadPool* current_pool = nullptr;
+thread_local size_t current_index = 0;
+
+} // namespace
+
+ThreadPool::ThreadPool(size_t num_threads) : queued(0), next_queue(0), stopping(false) {
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (size_t i = 0; i < num_threads; ++i) {
+        queues.push_back(std::make_unique<WorkerQueue>());
+    }
+    for (size_t i = 0; i < num_threads; ++i) {
+        workers.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+bool ThreadPool::popTask(size_t preferred, std::function<void()>& task) {
+    size_t n = queues.size();
+    if (n == 0) return false;
+
+    // Сначала своя очередь (LIFO - данные еще в кэше)
+    if (preferred < n) {
+        WorkerQueue& own = *queues[preferred];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+
+    // Затем перехват из чужих очередей (FIFO - самые крупные куски)
+    size_t start = preferred < n ? preferred + 1 : 0;
+    for (size_t offset = 0; offset < n; ++offset) {
+        WorkerQueue& victim = *queues[(start + offset) % n];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(size_t index) {
+    current_pool = this;
+    current_index = index;
+
+    std::function<void()> task;
+    while (true) {
+        if (popTask(index, task)) {
+            task();
+            task = nullptr;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(wake_mutex);
+        wake.wait(lock, [this] { return stopping || queued.load() > 0; });
+        if (stopping && queued.load() == 0) {
+            return;
+        }
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    size_t target = currentWorker();
+    if (target >= queues.size()) {
+        target = next_queue.fetch_add(1) % queues.size();
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues[target]->mutex);
+        queues[target]->tasks.push_back(std::move(task));
+    }
+    {
+        // Увеличение счетчика под wake_mutex исключает потерю пробуждения
+        std::lock_guard<std::mutex> lock(wake_mutex);
+        queued.fetch_add(1);
+    }
+    wake.notify_one();
+}
+
+void ThreadPool::parallelFor(size_t begin, size_t end, size_t grain,
+                             const std::function<void(size_t, size_t)>& body) {
+    if (begin >= end) return;
+    if (grain == 0) grain = 1;
+
+    size_t n_chunks = (end - begin + grain - 1) / grain;
+    if (n_chunks == 1 || workers.empty()) {
+        body(begin, end);
+        return;
+    }
+
+    struct Latch {
+        std::mutex mutex;
+        std::condition_variable done;
+        size_t remaining;
+        std::exception_ptr error;
+    };
+    auto latch = std::make_shared<Latch>();
+    latch->remaining = n_chunks;
+
+    for (size_t chunk = 0; chunk < n_chunks; ++chunk) {
+        size_t chunk_begin = begin + chunk * grain;
+        size_t chunk_end = std::min(end, chunk_begin + grain);
+        submit([latch, &body, chunk_begin, chunk_end] {
+            std::exception_ptr error;
+            try {
+                body(chunk_begin, chunk_end);
+            } catch (...) {
+                error = std::current_exception();
+            }
+            std::lock_guard<std::mutex> lock(latch->mutex);
+            if (error && !latch->error) {
+                latch->error = error;
+            }
+            if (--latch->remaining == 0) {
+                latch->done.notify_all();
+            }
+        });
+    }
+
+    // Вызывающий поток не простаивает, а выполняет задачи из очередей
+    size_t self = currentWorker();
+    std::function<void()> task;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(latch->mutex);
+            if (latch->remaining == 0) break;
+        }
+        if (popTask(self, task)) {
+            task();
+            task = nullptr;
+        } else {
+            std::unique_lock<std::mutex> lock(latch->mutex);
+            latch->done.wait(lock, [&latch] { return latch->remaining == 0; });
+            break;
+        }
+    }
+
+    if (latch->error) {
+        std::rethrow_exception(latch->error);
+    }
+}
+
+size_t ThreadPool::currentWorker() const {
+    return current_pool == this ? current_index : workers.size();
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool;
+    return pool;
+}
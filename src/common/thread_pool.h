@@ -0,0 +1,61 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <cstddef>
+
+// Постоянный пул потоков с перехватом задач (work stealing).
+// У каждого рабочего потока своя очередь: свои задачи он берет с конца,
+// при пустой очереди забирает задачи с начала чужих очередей.
+class ThreadPool {
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<WorkerQueue>> queues;
+    std::mutex wake_mutex;
+    std::condition_variable wake;
+    std::atomic<size_t> queued;
+    std::atomic<size_t> next_queue;
+    bool stopping;
+
+    void workerLoop(size_t index);
+    bool popTask(size_t preferred, std::function<void()>& task);
+
+public:
+    // num_threads == 0 - по числу аппаратных потоков
+    explicit ThreadPool(size_t num_threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const { return workers.size(); }
+
+    void submit(std::function<void()> task);
+
+    // Выполнение body(chunk_begin, chunk_end) для отрезков длины grain,
+    // покрывающих [begin, end). Вызывающий поток помогает выполнять задачи
+    // и возвращается, когда все отрезки обработаны. Первое исключение
+    // из body пробрасывается вызывающему.
+    void parallelFor(size_t begin, size_t end, size_t grain,
+                     const std::function<void(size_t, size_t)>& body);
+
+    // Номер рабочего потока пула, либо size() для внешнего потока
+    size_t currentWorker() const;
+
+    // Общий пул процесса по числу аппаратных потоков
+    static ThreadPool& shared();
+};
+
+#endif
@@ -2,25 +2,193 @@
 #define BLOWFISH_H
 
 #include <vector>
+#include <memory>
 #include <cstdint>
+#include <cstddef>
 #include <chrono>
+#include "thread_pool.h"
+#include "blowfish_kernels.h"
 
-class Blowfish {
+// Развернутый ключ: P-массив и S-блоки после стандартного расписания
+// ключа (521 шифрование блока). После создания не меняется, поэтому один
+// контекст разделяется между потоками и объектами Blowfish без копирования.
+class BlowfishContext {
 private:
     uint32_t P[18];
     uint32_t S[4][256];
-    
-    void generateSubkeys(const std::vector<uint8_t>& key);
-    uint32_t F(uint32_t x);
-    void encryptBlock(uint32_t& left, uint32_t& right);
-    void decryptBlock(uint32_t& left, uint32_t& right);
+
+    // Начальные таблицы (шестнадцатеричные цифры pi)
+    BlowfishContext();
+
+public:
+    // Ключ до 448 бит; короткий ключ повторяется по кругу
+    static constexpr size_t MIN_KEY_BYTES = 1;
+    static constexpr size_t MAX_KEY_BYTES = 56;
+
+    // Развертка ключа; nullptr при недопустимой длине
+    static std::shared_ptr<const BlowfishContext> expand(const uint8_t* key, size_t length);
+    static std::shared_ptr<const BlowfishContext> expand(const std::vector<uint8_t>& key);
+    // Контекст без ключа (общий для всех)
+    static std::shared_ptr<const BlowfishContext> initial();
+
+    // Таблицы для векторных ядер (blowfish_kernels.cpp)
+    const uint32_t* subkeys() const { return P; }
+    const uint32_t* sbox(int i) const { return S[i]; }
+
+    uint32_t F(uint32_t x) const {
+        return ((S[0][x >> 24] + S[1][(x >> 16) & 0xFF]) ^ S[2][(x >> 8) & 0xFF]) +
+               S[3][x & 0xFF];
+    }
+
+    // Раунды развернуты попарно, поэтому половины блока не переставляются
+    void encryptBlock(uint32_t& left, uint32_t& right) const {
+        uint32_t l = left, r = right;
+        for (int i = 0; i < 16; i += 2) {
+            l ^= P[i];
+            r ^= F(l);
+            r ^= P[i + 1];
+            l ^= F(r);
+        }
+        left = r ^ P[17];
+        right = l ^ P[16];
+    }
+
+    void decryptBlock(uint32_t& left, uint32_t& right) const {
+        uint32_t l = left, r = right;
+        for (int i = 17; i > 1; i -= 2) {
+            l ^= P[i];
+            r ^= F(l);
+            r ^= P[i - 1];
+            l ^= F(r);
+        }
+        left = r ^ P[0];
+        right = l ^ P[1];
+    }
+
+    // N независимых блоков за проход. Раунды одного блока зависят друг от
+    // друга через чтения S-блоков, а раунды разных блоков - нет, поэтому
+    // задержки этих чтений перекрываются.
+    template <size_t N>
+    void encryptBlocks(uint32_t* left, uint32_t* right) const {
+        for (int i = 0; i < 16; i += 2) {
+            for (size_t b = 0; b < N; ++b) left[b] ^= P[i];
+            for (size_t b = 0; b < N; ++b) right[b] ^= F(left[b]) ^ P[i + 1];
+            for (size_t b = 0; b < N; ++b) left[b] ^= F(right[b]);
+        }
+        for (size_t b = 0; b < N; ++b) {
+            uint32_t l = left[b];
+            left[b] = right[b] ^ P[17];
+            right[b] = l ^ P[16];
+        }
+    }
+
+    template <size_t N>
+    void decryptBlocks(uint32_t* left, uint32_t* right) const {
+        for (int i = 17; i > 1; i -= 2) {
+            for (size_t b = 0; b < N; ++b) left[b] ^= P[i];
+            for (size_t b = 0; b < N; ++b) right[b] ^= F(left[b]) ^ P[i - 1];
+            for (size_t b = 0; b < N; ++b) left[b] ^= F(right[b]);
+        }
+        for (size_t b = 0; b < N; ++b) {
+            uint32_t l = left[b];
+            left[b] = right[b] ^ P[0];
+            right[b] = l ^ P[1];
+        }
+    }
+};
+
+// Пакет для пакетного шифрования (по образцу iovec): length байт из in
+// шифруются в out (out может совпадать с in) в режиме CTR со своим
+// начальным счетчиком iv
+struct BlowfishPacket {
+    const uint8_t* in;
+    uint8_t* out;
+    size_t length;
+    uint64_t iv;
+};
+
+class Blowfish {
+private:
+    std::shared_ptr<const BlowfishContext> key_context;
+    const BlowfishKernels* kernels;
+    // Собственный пул при явно заданном числе потоков, иначе общий
+    std::shared_ptr<ThreadPool> own_pool;
+    size_t num_threads;
+
+    ThreadPool* pool() const;
     
 public:
+    static constexpr size_t BLOCK_SIZE = 8;
+
     Blowfish();
-    void setKey(const std::vector<uint8_t>& key);
-    std::vector<uint8_t> encrypt(const std::vector<uint8_t>& data);
-    std::vector<uint8_t> decrypt(const std::vector<uint8_t>& data);
+    explicit Blowfish(std::shared_ptr<const BlowfishContext> context);
+    // Развертка ключа; false (и прежний ключ) при недопустимой длине
+    bool setKey(const std::vector<uint8_t>& key);
+    // Готовый контекст, например из BlowfishKeyCache
+    void setContext(std::shared_ptr<const BlowfishContext> context);
+    const std::shared_ptr<const BlowfishContext>& context() const { return key_context; }
+    // Принудительный выбор ядра пакетного шифрования (по умолчанию -
+    // по возможностям CPU); используется ECB, CTR и расшифровкой CBC
+    void setSimdLevel(BlowfishSimd level);
+    const char* simdName() const { return kernels->name; }
+
+    // Дополнение PKCS#7: всегда от 1 до 8 байт, даже при длине, кратной блоку
+    static size_t paddedSize(size_t length) { return length + BLOCK_SIZE - length % BLOCK_SIZE; }
+    // Дописывает дополнение после length байт buffer; capacity - размер
+    // буфера. Возвращает дополненную длину, 0 - если буфер мал.
+    static size_t pad(uint8_t* buffer, size_t length, size_t capacity);
+    // Длина данных без дополнения; false, если дополнение некорректно
+    static bool unpaddedSize(const uint8_t* data, size_t length, size_t& plain_length);
+
+    // Шифрование целых блоков на месте (length кратно BLOCK_SIZE)
+    // пакетами независимых блоков через выбранное ядро
+    void encryptBlocks(uint8_t* data, size_t length) const;
+    void decryptBlocks(uint8_t* data, size_t length) const;
+
+    // Без выделения памяти: выход в буфер вызывающего. out может совпадать
+    // с in (шифрование на месте), out_capacity >= paddedSize(length).
+    bool encrypt(const uint8_t* in, size_t length, uint8_t* out, size_t out_capacity,
+                 size_t& out_length) const;
+    // out вмещает length байт; out_length - длина без дополнения
+    bool decrypt(const uint8_t* in, size_t length, uint8_t* out, size_t& out_length) const;
+
+    // Число потоков для CTR и расшифровки CBC на больших буферах:
+    // 0 - общий пул, 1 - последовательно, n - свой пул из n потоков
+    void setNumThreads(size_t n);
+
+    // CTR: гамма - шифр от (iv + номер блока) как 64-битного числа
+    // big-endian. Шифрование и расшифровка совпадают, дополнения нет.
+    // offset - позиция in в потоке в байтах (произвольный доступ);
+    // большой буфер делится между потоками по диапазонам счетчика.
+    // out может совпадать с in.
+    void ctr(const uint8_t* in, size_t length, uint8_t* out, uint64_t iv,
+             uint64_t offset = 0) const;
+
+    // CTR для набора пакетов одним вызовом. Блоки гаммы разных пакетов
+    // собираются в общие пакеты ядра, поэтому короткие пакеты не
+    // оставляют его недогруженным; большой набор делится между потоками.
+    void ctrPackets(const BlowfishPacket* packets, size_t count) const;
+    void ctrPackets(const std::vector<BlowfishPacket>& packets) const {
+        ctrPackets(packets.data(), packets.size());
+    }
+
+    // CBC с дополнением PKCS#7. Шифрование последовательно по природе
+    // режима; при расшифровке блок зависит только от двух шифроблоков,
+    // поэтому она выполняется параллельно. out совпадает с in или
+    // не пересекается с ним.
+    bool encryptCBC(const uint8_t* in, size_t length, uint8_t* out, size_t out_capacity,
+                    size_t& out_length, uint64_t iv) const;
+    bool decryptCBC(const uint8_t* in, size_t length, uint8_t* out, size_t& out_length,
+                    uint64_t iv) const;
+    // Цепочка CBC по целым блокам без дополнения (для потоковой обработки).
+    // Возвращают последний шифроблок - iv для продолжения цепочки.
+    uint64_t encryptCBCBlocks(const uint8_t* in, size_t length, uint8_t* out, uint64_t iv) const;
+    uint64_t decryptCBCBlocks(const uint8_t* in, size_t length, uint8_t* out, uint64_t iv) const;
+
+    // Обертки над буферным API
+    std::vector<uint8_t> encrypt(const std::vector<uint8_t>& data) const;
+    std::vector<uint8_t> decrypt(const std::vector<uint8_t>& data) const;
     double measureEncryptionDelay(const std::vector<uint8_t>& data);
 };
 
-#endif
\ No newline at end of file
+#endif
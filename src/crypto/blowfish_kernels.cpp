@@ -0,0 +1,175 @@
+#include "blowfish_kernels.h"
+#include "blowfish.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BLOWFISH_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+template <bool Encrypt>
+void blocksScalar(const BlowfishContext& ctx, uint32_t* left, uint32_t* right, size_t count) {
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        if (Encrypt) {
+            ctx.encryptBlocks<8>(left + i, right + i);
+        } else {
+            ctx.decryptBlocks<8>(left + i, right + i);
+        }
+    }
+    for (; i < count; ++i) {
+        if (Encrypt) {
+            ctx.encryptBlock(left[i], right[i]);
+        } else {
+            ctx.decryptBlock(left[i], right[i]);
+        }
+    }
+}
+
+#ifdef BLOWFISH_X86_DISPATCH
+
+// F для 8 блоков: четыре выборки из S-блоков - по одной инструкции сбора
+__attribute__((target("avx2")))
+inline __m256i feistelAVX2(const BlowfishContext& ctx, __m256i x) {
+    const __m256i mask = _mm256_set1_epi32(0xFF);
+    const int* s0 = reinterpret_cast<const int*>(ctx.sbox(0));
+    const int* s1 = reinterpret_cast<const int*>(ctx.sbox(1));
+    const int* s2 = reinterpret_cast<const int*>(ctx.sbox(2));
+    const int* s3 = reinterpret_cast<const int*>(ctx.sbox(3));
+    __m256i a = _mm256_i32gather_epi32(s0, _mm256_srli_epi32(x, 24), 4);
+    __m256i b = _mm256_i32gather_epi32(s1, _mm256_and_si256(_mm256_srli_epi32(x, 16), mask), 4);
+    __m256i c = _mm256_i32gather_epi32(s2, _mm256_and_si256(_mm256_srli_epi32(x, 8), mask), 4);
+    __m256i d = _mm256_i32gather_epi32(s3, _mm256_and_si256(x, mask), 4);
+    return _mm256_add_epi32(_mm256_xor_si256(_mm256_add_epi32(a, b), c), d);
+}
+
+// Раунды V независимых векторов чередуются: сбор из S-блоков имеет
+// большую задержку, и один вектор ждал бы его на каждом раунде
+template <bool Encrypt, int V>
+__attribute__((target("avx2")))
+inline void roundsAVX2(const BlowfishContext& ctx, uint32_t* left, uint32_t* right) {
+    const uint32_t* P = ctx.subkeys();
+    __m256i l[V], r[V];
+    for (int v = 0; v < V; ++v) {
+        l[v] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(left + 8 * v));
+        r[v] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(right + 8 * v));
+    }
+    for (int round = 0; round < 16; round += 2) {
+        int k = Encrypt ? round : 17 - round;
+        __m256i pk = _mm256_set1_epi32(static_cast<int>(P[k]));
+        __m256i pn = _mm256_set1_epi32(static_cast<int>(P[Encrypt ? k + 1 : k - 1]));
+        for (int v = 0; v < V; ++v) l[v] = _mm256_xor_si256(l[v], pk);
+        for (int v = 0; v < V; ++v) {
+            r[v] = _mm256_xor_si256(r[v], _mm256_xor_si256(feistelAVX2(ctx, l[v]), pn));
+        }
+        for (int v = 0; v < V; ++v) l[v] = _mm256_xor_si256(l[v], feistelAVX2(ctx, r[v]));
+    }
+    __m256i p_left = _mm256_set1_epi32(static_cast<int>(P[Encrypt ? 17 : 0]));
+    __m256i p_right = _mm256_set1_epi32(static_cast<int>(P[Encrypt ? 16 : 1]));
+    for (int v = 0; v < V; ++v) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(left + 8 * v), _mm256_xor_si256(r[v], p_left));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(right + 8 * v), _mm256_xor_si256(l[v], p_right));
+    }
+}
+
+template <bool Encrypt>
+__attribute__((target("avx2")))
+void blocksAVX2(const BlowfishContext& ctx, uint32_t* left, uint32_t* right, size_t count) {
+    size_t i = 0;
+    for (; i + 32 <= count; i += 32) roundsAVX2<Encrypt, 4>(ctx, left + i, right + i);
+    for (; i + 8 <= count; i += 8) roundsAVX2<Encrypt, 1>(ctx, left + i, right + i);
+    blocksScalar<Encrypt>(ctx, left + i, right + i, count - i);
+}
+
+// Маскированные формы (полная маска) вместо _mm512_srli_epi32 и
+// _mm512_i32gather_epi32: у GCC 12 те дают ложное -Wmaybe-uninitialized
+__attribute__((target("avx512f")))
+inline __m512i gatherAVX512(const uint32_t* table, __m512i index) {
+    return _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), 0xFFFF, index, table, 4);
+}
+
+__attribute__((target("avx512f")))
+inline __m512i feistelAVX512(const BlowfishContext& ctx, __m512i x) {
+    const __m512i mask = _mm512_set1_epi32(0xFF);
+    __m512i a = gatherAVX512(ctx.sbox(0), _mm512_maskz_srli_epi32(0xFFFF, x, 24));
+    __m512i b = gatherAVX512(ctx.sbox(1), _mm512_and_si512(_mm512_maskz_srli_epi32(0xFFFF, x, 16), mask));
+    __m512i c = gatherAVX512(ctx.sbox(2), _mm512_and_si512(_mm512_maskz_srli_epi32(0xFFFF, x, 8), mask));
+    __m512i d = gatherAVX512(ctx.sbox(3), _mm512_and_si512(x, mask));
+    return _mm512_add_epi32(_mm512_xor_si512(_mm512_add_epi32(a, b), c), d);
+}
+
+template <bool Encrypt, int V>
+__attribute__((target("avx512f")))
+inline void roundsAVX512(const BlowfishContext& ctx, uint32_t* left, uint32_t* right) {
+    const uint32_t* P = ctx.subkeys();
+    __m512i l[V], r[V];
+    for (int v = 0; v < V; ++v) {
+        l[v] = _mm512_loadu_si512(left + 16 * v);
+        r[v] = _mm512_loadu_si512(right + 16 * v);
+    }
+    for (int round = 0; round < 16; round += 2) {
+        int k = Encrypt ? round : 17 - round;
+        __m512i pk = _mm512_set1_epi32(static_cast<int>(P[k]));
+        __m512i pn = _mm512_set1_epi32(static_cast<int>(P[Encrypt ? k + 1 : k - 1]));
+        for (int v = 0; v < V; ++v) l[v] = _mm512_xor_si512(l[v], pk);
+        for (int v = 0; v < V; ++v) {
+            r[v] = _mm512_xor_si512(r[v], _mm512_xor_si512(feistelAVX512(ctx, l[v]), pn));
+        }
+        for (int v = 0; v < V; ++v) l[v] = _mm512_xor_si512(l[v], feistelAVX512(ctx, r[v]));
+    }
+    __m512i p_left = _mm512_set1_epi32(static_cast<int>(P[Encrypt ? 17 : 0]));
+    __m512i p_right = _mm512_set1_epi32(static_cast<int>(P[Encrypt ? 16 : 1]));
+    for (int v = 0; v < V; ++v) {
+        _mm512_storeu_si512(left + 16 * v, _mm512_xor_si512(r[v], p_left));
+        _mm512_storeu_si512(right + 16 * v, _mm512_xor_si512(l[v], p_right));
+    }
+}
+
+template <bool Encrypt>
+__attribute__((target("avx512f")))
+void blocksAVX512(const BlowfishContext& ctx, uint32_t* left, uint32_t* right, size_t count) {
+    size_t i = 0;
+    for (; i + 64 <= count; i += 64) roundsAVX512<Encrypt, 4>(ctx, left + i, right + i);
+    for (; i + 16 <= count; i += 16) roundsAVX512<Encrypt, 1>(ctx, left + i, right + i);
+    // Хвост меньше 16 блоков - векторами по 8
+    blocksAVX2<Encrypt>(ctx, left + i, right + i, count - i);
+}
+
+#endif
+
+const BlowfishKernels SCALAR_KERNELS = {
+    BlowfishSimd::Scalar, "scalar", blocksScalar<true>, blocksScalar<false>};
+#ifdef BLOWFISH_X86_DISPATCH
+const BlowfishKernels AVX2_KERNELS = {
+    BlowfishSimd::AVX2, "avx2-gather", blocksAVX2<true>, blocksAVX2<false>};
+const BlowfishKernels AVX512_KERNELS = {
+    BlowfishSimd::AVX512, "avx512-gather", blocksAVX512<true>, blocksAVX512<false>};
+#endif
+
+} // namespace
+
+BlowfishSimd detectBlowfishSimd() {
+#ifdef BLOWFISH_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return BlowfishSimd::AVX512;
+    if (__builtin_cpu_supports("avx2")) return BlowfishSimd::AVX2;
+#endif
+    return BlowfishSimd::Scalar;
+}
+
+const BlowfishKernels& blowfishKernelsFor(BlowfishSimd level) {
+#ifdef BLOWFISH_X86_DISPATCH
+    BlowfishSimd supported = detectBlowfishSimd();
+    if (level == BlowfishSimd::AVX512 && supported == BlowfishSimd::AVX512) return AVX512_KERNELS;
+    if (level != BlowfishSimd::Scalar && supported != BlowfishSimd::Scalar) return AVX2_KERNELS;
+#else
+    (void)level;
+#endif
+    return SCALAR_KERNELS;
+}
+
+const BlowfishKernels& blowfishKernels() {
+    static const BlowfishKernels& selected = blowfishKernelsFor(detectBlowfishSimd());
+    return selected;
+}
@@ -0,0 +1,38 @@
+#ifndef BLOWFISH_KERNELS_H
+#define BLOWFISH_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+class BlowfishContext;
+
+// Набор SIMD-инструкций для пакетного шифрования блоков
+enum class BlowfishSimd {
+    Scalar,   // чередование 8 блоков в регистрах общего назначения
+    AVX2,     // 8 блоков в векторе, S-блоки - через vpgatherdd
+    AVX512    // 16 блоков в векторе
+};
+
+// Шифрование count блоков, разложенных по половинам: left[i], right[i] -
+// старшее и младшее слово i-го блока. Результат - на месте.
+using BlowfishBlocksFn = void (*)(const BlowfishContext& ctx,
+                                  uint32_t* left, uint32_t* right, size_t count);
+
+struct BlowfishKernels {
+    BlowfishSimd level;
+    const char* name;
+    BlowfishBlocksFn encrypt;
+    BlowfishBlocksFn decrypt;
+};
+
+// Определение возможностей процессора во время выполнения
+BlowfishSimd detectBlowfishSimd();
+
+// Ядра для заданного уровня (если он не поддерживается сборкой или
+// процессором - ближайший доступный более низкий уровень)
+const BlowfishKernels& blowfishKernelsFor(BlowfishSimd level);
+
+// Ядра, выбранные один раз при первом вызове по detectBlowfishSimd()
+const BlowfishKernels& blowfishKernels();
+
+#endif
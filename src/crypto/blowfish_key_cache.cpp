@@ -0,0 +1,96 @@
+#include "blowfish_key_cache.h"
+#include <algorithm>
+
+BlowfishKeyCache::BlowfishKeyCache(size_t capacity)
+    : capacity(std::max<size_t>(capacity, 1)), hit_count(0), miss_count(0) {}
+
+std::shared_ptr<const BlowfishContext> BlowfishKeyCache::findLocked(uint64_t key_id) {
+    auto found = positions.find(key_id);
+    if (found == positions.end()) return nullptr;
+    entries.splice(entries.begin(), entries, found->second);
+    return found->second->second;
+}
+
+void BlowfishKeyCache::insertLocked(uint64_t key_id,
+                                    std::shared_ptr<const BlowfishContext> context) {
+    auto found = positions.find(key_id);
+    if (found != positions.end()) {
+        found->second->second = std::move(context);
+        entries.splice(entries.begin(), entries, found->second);
+        return;
+    }
+    entries.emplace_front(key_id, std::move(context));
+    positions[key_id] = entries.begin();
+    if (entries.size() > capacity) {
+        positions.erase(entries.back().first);
+        entries.pop_back();
+    }
+}
+
+std::shared_ptr<const BlowfishContext> BlowfishKeyCache::find(uint64_t key_id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto context = findLocked(key_id);
+    ++(context ? hit_count : miss_count);
+    return context;
+}
+
+std::shared_ptr<const BlowfishContext> BlowfishKeyCache::get(uint64_t key_id, const uint8_t* key,
+                                                             size_t length) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (auto context = findLocked(key_id)) {
+            ++hit_count;
+            return context;
+        }
+        ++miss_count;
+    }
+
+    auto context = BlowfishContext::expand(key, length);
+    if (!context) return nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    // Пока ключ разворачивался, его мог добавить другой поток
+    if (auto existing = findLocked(key_id)) return existing;
+    insertLocked(key_id, context);
+    return context;
+}
+
+std::shared_ptr<const BlowfishContext> BlowfishKeyCache::get(uint64_t key_id,
+                                                             const std::vector<uint8_t>& key) {
+    return get(key_id, key.data(), key.size());
+}
+
+void BlowfishKeyCache::insert(uint64_t key_id, std::shared_ptr<const BlowfishContext> context) {
+    if (!context) return;
+    std::lock_guard<std::mutex> lock(mutex);
+    insertLocked(key_id, std::move(context));
+}
+
+void BlowfishKeyCache::erase(uint64_t key_id) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = positions.find(key_id);
+    if (found == positions.end()) return;
+    entries.erase(found->second);
+    positions.erase(found);
+}
+
+void BlowfishKeyCache::clear() {
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    positions.clear();
+}
+
+size_t BlowfishKeyCache::size() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return entries.size();
+}
+
+size_t BlowfishKeyCache::hits() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return hit_count;
+}
+
+size_t BlowfishKeyCache::misses() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return miss_count;
+}
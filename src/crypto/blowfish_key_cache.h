@@ -0,0 +1,48 @@
+#ifndef BLOWFISH_KEY_CACHE_H
+#define BLOWFISH_KEY_CACHE_H
+
+#include <list>
+#include <mutex>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include "blowfish.h"
+
+// LRU-кэш развернутых ключей по идентификатору ключа (например, номеру
+// потока). Развертка - 521 шифрование и около 4 КБ таблиц, поэтому при
+// ключах на поток ее выгодно выполнять один раз. Потокобезопасен;
+// выданные контексты остаются действительными и после вытеснения.
+class BlowfishKeyCache {
+private:
+    using Entry = std::pair<uint64_t, std::shared_ptr<const BlowfishContext>>;
+
+    size_t capacity;
+    std::list<Entry> entries;   // в начале - недавно использованные
+    std::unordered_map<uint64_t, std::list<Entry>::iterator> positions;
+    mutable std::mutex mutex;
+    size_t hit_count;
+    size_t miss_count;
+
+    std::shared_ptr<const BlowfishContext> findLocked(uint64_t key_id);
+    void insertLocked(uint64_t key_id, std::shared_ptr<const BlowfishContext> context);
+
+public:
+    explicit BlowfishKeyCache(size_t capacity = 1024);
+
+    // Контекст по идентификатору; nullptr, если его нет в кэше
+    std::shared_ptr<const BlowfishContext> find(uint64_t key_id);
+    // Контекст из кэша, при промахе - развертка key (вне блокировки,
+    // другие потоки не ждут). nullptr при недопустимом ключе.
+    std::shared_ptr<const BlowfishContext> get(uint64_t key_id, const uint8_t* key, size_t length);
+    std::shared_ptr<const BlowfishContext> get(uint64_t key_id, const std::vector<uint8_t>& key);
+    void insert(uint64_t key_id, std::shared_ptr<const BlowfishContext> context);
+    void erase(uint64_t key_id);
+    void clear();
+
+    size_t size() const;
+    size_t hits() const;
+    size_t misses() const;
+};
+
+#endif
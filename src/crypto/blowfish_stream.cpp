@@ -0,0 +1,188 @@
+#include "blowfish_stream.h"
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+namespace {
+
+constexpr size_t BLOCK = Blowfish::BLOCK_SIZE;
+
+bool checkUsable(bool finished) {
+    if (finished) {
+        std::cerr << "Ошибка: поток уже завершен (finalize), нужен reset" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool checkCapacity(size_t needed, size_t capacity) {
+    if (capacity < needed) {
+        std::cerr << "Ошибка: выходной буфер мал (" << capacity << " < " << needed
+                  << " байт)" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+}
+
+BlowfishEncryptor::BlowfishEncryptor(std::shared_ptr<const BlowfishContext> context,
+                                     BlowfishMode mode, uint64_t iv)
+    : cipher(std::move(context)), mode(mode) {
+    reset(iv);
+}
+
+void BlowfishEncryptor::reset(uint64_t iv) {
+    start_iv = iv;
+    chain = iv;
+    position = 0;
+    pending_length = 0;
+    finished = false;
+}
+
+size_t BlowfishEncryptor::updateSize(size_t length) const {
+    if (mode == BlowfishMode::CTR) return length;
+    return (pending_length + length) / BLOCK * BLOCK;
+}
+
+bool BlowfishEncryptor::update(const uint8_t* in, size_t length, uint8_t* out,
+                               size_t out_capacity, size_t& out_length) {
+    out_length = 0;
+    if (!checkUsable(finished) || !checkCapacity(updateSize(length), out_capacity)) return false;
+
+    if (mode == BlowfishMode::CTR) {
+        cipher.ctr(in, length, out, start_iv, position);
+        position += length;
+        out_length = length;
+        return true;
+    }
+
+    // Сначала дополняется перенесенный неполный блок
+    if (pending_length > 0) {
+        size_t take = std::min(BLOCK - pending_length, length);
+        std::memcpy(pending + pending_length, in, take);
+        pending_length += take;
+        in += take;
+        length -= take;
+        if (pending_length < BLOCK) return true;
+        chain = cipher.encryptCBCBlocks(pending, BLOCK, out, chain);
+        out += BLOCK;
+        out_length += BLOCK;
+        pending_length = 0;
+    }
+
+    size_t whole = length / BLOCK * BLOCK;
+    chain = cipher.encryptCBCBlocks(in, whole, out, chain);
+    out_length += whole;
+    pending_length = length - whole;
+    std::memcpy(pending, in + whole, pending_length);
+    return true;
+}
+
+bool BlowfishEncryptor::finalize(uint8_t* out, size_t out_capacity, size_t& out_length) {
+    out_length = 0;
+    if (!checkUsable(finished)) return false;
+    if (mode == BlowfishMode::CTR) {
+        finished = true;
+        return true;
+    }
+    if (!checkCapacity(BLOCK, out_capacity)) return false;
+
+    Blowfish::pad(pending, pending_length, BLOCK);
+    chain = cipher.encryptCBCBlocks(pending, BLOCK, out, chain);
+    out_length = BLOCK;
+    pending_length = 0;
+    finished = true;
+    return true;
+}
+
+BlowfishDecryptor::BlowfishDecryptor(std::shared_ptr<const BlowfishContext> context,
+                                     BlowfishMode mode, uint64_t iv)
+    : cipher(std::move(context)), mode(mode) {
+    reset(iv);
+}
+
+void BlowfishDecryptor::reset(uint64_t iv) {
+    start_iv = iv;
+    chain = iv;
+    position = 0;
+    pending_length = 0;
+    finished = false;
+}
+
+size_t BlowfishDecryptor::updateSize(size_t length) const {
+    if (mode == BlowfishMode::CTR) return length;
+    // Последний полный блок удерживается: он может содержать дополнение
+    size_t total = pending_length + length;
+    size_t blocks = total / BLOCK;
+    if (blocks > 0 && total % BLOCK == 0) --blocks;
+    return blocks * BLOCK;
+}
+
+bool BlowfishDecryptor::update(const uint8_t* in, size_t length, uint8_t* out,
+                               size_t out_capacity, size_t& out_length) {
+    out_length = 0;
+    if (!checkUsable(finished) || !checkCapacity(updateSize(length), out_capacity)) return false;
+
+    if (mode == BlowfishMode::CTR) {
+        cipher.ctr(in, length, out, start_iv, position);
+        position += length;
+        out_length = length;
+        return true;
+    }
+
+    size_t emit = updateSize(length);
+    if (emit == 0) {
+        std::memcpy(pending + pending_length, in, length);
+        pending_length += length;
+        return true;
+    }
+
+    // Перенесенный блок дополняется и расшифровывается первым
+    if (pending_length > 0) {
+        size_t take = BLOCK - pending_length;
+        std::memcpy(pending + pending_length, in, take);
+        chain = cipher.decryptCBCBlocks(pending, BLOCK, out, chain);
+        in += take;
+        length -= take;
+        out += BLOCK;
+        out_length += BLOCK;
+        emit -= BLOCK;
+        pending_length = 0;
+    }
+
+    chain = cipher.decryptCBCBlocks(in, emit, out, chain);
+    out_length += emit;
+    pending_length = length - emit;
+    std::memcpy(pending, in + emit, pending_length);
+    return true;
+}
+
+bool BlowfishDecryptor::finalize(uint8_t* out, size_t out_capacity, size_t& out_length) {
+    out_length = 0;
+    if (!checkUsable(finished)) return false;
+    if (mode == BlowfishMode::CTR) {
+        finished = true;
+        return true;
+    }
+
+    if (pending_length != BLOCK) {
+        std::cerr << "Ошибка: длина шифротекста не кратна блоку" << std::endl;
+        finished = true;
+        return false;
+    }
+    uint8_t block[BLOCK];
+    cipher.decryptCBCBlocks(pending, BLOCK, block, chain);
+    size_t plain_length = 0;
+    if (!Blowfish::unpaddedSize(block, BLOCK, plain_length)) {
+        std::cerr << "Ошибка: некорректное дополнение" << std::endl;
+        finished = true;
+        return false;
+    }
+    // При малом буфере поток не завершается: finalize можно повторить
+    if (!checkCapacity(plain_length, out_capacity)) return false;
+    std::memcpy(out, block, plain_length);
+    out_length = plain_length;
+    finished = true;
+    return true;
+}
@@ -0,0 +1,73 @@
+#ifndef BLOWFISH_STREAM_H
+#define BLOWFISH_STREAM_H
+
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+#include "blowfish.h"
+
+// Режим потокового шифрования
+enum class BlowfishMode {
+    CTR,   // без дополнения, вывод update равен вводу
+    CBC    // PKCS#7, неполный блок переносится между вызовами
+};
+
+// Потоковое шифрование входа произвольной длины кусками произвольного
+// размера: состояние режима и неполный блок хранятся между вызовами,
+// вывод - в буфер вызывающего, память постоянна. out не пересекается
+// с in (в режиме CTR допустимо out == in).
+class BlowfishEncryptor {
+private:
+    Blowfish cipher;
+    BlowfishMode mode;
+    uint64_t start_iv;
+    uint64_t chain;          // CBC: последний шифроблок
+    uint64_t position;       // CTR: обработано байт
+    uint8_t pending[Blowfish::BLOCK_SIZE];
+    size_t pending_length;
+    bool finished;
+
+public:
+    BlowfishEncryptor(std::shared_ptr<const BlowfishContext> context, BlowfishMode mode,
+                      uint64_t iv);
+
+    // Число потоков для CTR (см. Blowfish::setNumThreads)
+    void setNumThreads(size_t n) { cipher.setNumThreads(n); }
+    // Наибольший вывод update для length байт ввода
+    size_t updateSize(size_t length) const;
+    bool update(const uint8_t* in, size_t length, uint8_t* out, size_t out_capacity,
+                size_t& out_length);
+    // CBC: последний блок с дополнением (8 байт), CTR: пусто
+    bool finalize(uint8_t* out, size_t out_capacity, size_t& out_length);
+    // Новый поток с тем же ключом
+    void reset(uint64_t iv);
+};
+
+// Потоковая расшифровка. В режиме CBC последний полный блок удерживается
+// до finalize, где проверяется и снимается дополнение.
+class BlowfishDecryptor {
+private:
+    Blowfish cipher;
+    BlowfishMode mode;
+    uint64_t start_iv;
+    uint64_t chain;
+    uint64_t position;
+    uint8_t pending[Blowfish::BLOCK_SIZE];
+    size_t pending_length;
+    bool finished;
+
+public:
+    BlowfishDecryptor(std::shared_ptr<const BlowfishContext> context, BlowfishMode mode,
+                      uint64_t iv);
+
+    void setNumThreads(size_t n) { cipher.setNumThreads(n); }
+    size_t updateSize(size_t length) const;
+    bool update(const uint8_t* in, size_t length, uint8_t* out, size_t out_capacity,
+                size_t& out_length);
+    // CBC: остаток последнего блока без дополнения (до 7 байт);
+    // false при обрезанном вводе или некорректном дополнении
+    bool finalize(uint8_t* out, size_t out_capacity, size_t& out_length);
+    void reset(uint64_t iv);
+};
+
+#endif
@@ -8,8 +8,26 @@
 #include <algorithm>
 #include <map>
 #include <random>
+#include <cstdio>
+#include <cstring>
+#include <cctype>
+#include <memory>
+#include <thread>
 #include "ml/knn_classifier.h"
+#include "ml/data_processor.h"
+#include "ml/cross_validation.h"
 #include "crypto/blowfish.h"
+#include "crypto/blowfish_key_cache.h"
+#include "crypto/blowfish_stream.h"
+#include "common/mapped_file.h"
+#include "common/thread_pool.h"
+#include <charconv>
+#include <filesystem>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#define HAS_RUSAGE 1
+#endif
 
 // Простые демонстрационные тесты
 void runSimpleKNNTests() {
@@ -155,17 +173,361 @@ void performanceTestKNN() {
     std::cout << "Report saved to knn_performance.csv" << std::endl;
 }
 
+void performanceTestANN() {
+    std::cout << "\n=== KNN Approximate Search (HNSW) Test ===" << std::endl;
+
+    std::ofstream report("ann_performance.csv");
+    report << "EfSearch,Recall_at_10,Latency_us,Speedup\n";
+
+    const int n_train = 20000;
+    const int n_queries = 500;
+    const int n_features = 20;
+    const int k = 10;
+
+    // Кластеризованные данные: ближе к реальному трафику, чем равномерный шум
+    std::mt19937 gen(12345);
+    std::uniform_real_distribution<> unit(0.0, 1.0);
+    std::normal_distribution<> noise(0.0, 0.05);
+
+    std::vector<std::vector<double>> centers(50, std::vector<double>(n_features));
+    for (auto& center : centers) {
+        for (auto& value : center) value = unit(gen);
+    }
+    auto makeSample = [&](int i) {
+        std::vector<double> sample(n_features);
+        const auto& center = centers[i % centers.size()];
+        for (int j = 0; j < n_features; ++j) {
+            sample[j] = center[j] + noise(gen);
+        }
+        return sample;
+    };
+
+    std::vector<std::vector<double>> train_data;
+    std::vector<std::string> train_labels;
+    for (int i = 0; i < n_train; ++i) {
+        train_data.push_back(makeSample(i));
+        train_labels.push_back(i % 3 == 0 ? "Attack" : "Normal");
+    }
+    std::vector<std::vector<double>> queries;
+    for (int i = 0; i < n_queries; ++i) {
+        queries.push_back(makeSample(i));
+    }
+
+    // Точные соседи полным перебором
+    KNNClassifier exact;
+    exact.setIndexType(KNNClassifier::IndexType::BruteForce);
+    exact.fit(train_data, train_labels);
+
+    std::vector<std::vector<Neighbour>> truth;
+    auto start = std::chrono::high_resolution_clock::now();
+    for (const auto& query : queries) {
+        truth.push_back(exact.findNeighbours(query, k));
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    double exact_us = std::chrono::duration<double, std::micro>(end - start).count() / n_queries;
+
+    KNNClassifier approx;
+    approx.setIndexType(KNNClassifier::IndexType::HNSW);
+    start = std::chrono::high_resolution_clock::now();
+    approx.fit(train_data, train_labels);
+    end = std::chrono::high_resolution_clock::now();
+
+    std::cout << "Brute force: " << std::fixed << std::setprecision(2) << exact_us
+              << " us/query, HNSW build: "
+              << std::chrono::duration<double, std::milli>(end - start).count()
+              << " ms (" << n_train << " x " << n_features << ")" << std::endl;
+
+    for (size_t ef : {10, 20, 40, 80, 160, 320}) {
+        approx.setEfSearch(ef);
+
+        size_t hits = 0;
+        start = std::chrono::high_resolution_clock::now();
+        std::vector<std::vector<Neighbour>> found;
+        for (const auto& query : queries) {
+            found.push_back(approx.findNeighbours(query, k));
+        }
+        end = std::chrono::high_resolution_clock::now();
+        double latency_us = std::chrono::duration<double, std::micro>(end - start).count() / n_queries;
+
+        for (int q = 0; q < n_queries; ++q) {
+            for (const auto& neighbour : found[q]) {
+                for (const auto& expected : truth[q]) {
+                    if (neighbour.index == expected.index) {
+                        ++hits;
+                        break;
+                    }
+                }
+            }
+        }
+        double recall = static_cast<double>(hits) / (n_queries * k);
+
+        report << ef << "," << recall << "," << latency_us << "," << exact_us / latency_us << "\n";
+        std::cout << "efSearch: " << ef
+                  << ", Recall@" << k << ": " << std::setprecision(3) << recall
+                  << ", Latency: " << std::setprecision(2) << latency_us << " us"
+                  << ", Speedup: " << exact_us / latency_us << "x" << std::endl;
+    }
+
+    report.close();
+    std::cout << "Report saved to ann_performance.csv" << std::endl;
+}
+
+void performanceTestPrecision() {
+    std::cout << "\n=== KNN Storage Precision Test ===" << std::endl;
+
+    std::ofstream report("precision_performance.csv");
+    report << "Precision,F1_Score,F1_Delta,Memory_KB,Time_ms\n";
+
+    const int n_train = 5000;
+    const int n_test = 1000;
+    const int n_features = 40;
+
+    // Признаки в [0, 1], как после DataProcessor::normalizeFeatures;
+    // класс определяется кластером, к которому относится точка
+    std::mt19937 gen(2024);
+    std::uniform_real_distribution<> unit(0.0, 1.0);
+    std::normal_distribution<> noise(0.0, 0.45);
+    std::vector<std::vector<double>> centers(6, std::vector<double>(n_features));
+    for (auto& center : centers) {
+        for (auto& value : center) value = unit(gen);
+    }
+    const std::vector<std::string> classes = {"Normal", "DoS", "Probe"};
+
+    auto generate = [&](int count, std::vector<std::vector<double>>& data,
+                        std::vector<std::string>& labels) {
+        for (int i = 0; i < count; ++i) {
+            size_t cluster = gen() % centers.size();
+            std::vector<double> sample(n_features);
+            for (int j = 0; j < n_features; ++j) {
+                sample[j] = std::min(1.0, std::max(0.0, centers[cluster][j] + noise(gen)));
+            }
+            data.push_back(sample);
+            labels.push_back(classes[cluster % classes.size()]);
+        }
+    };
+
+    std::vector<std::vector<double>> train_data, test_data;
+    std::vector<std::string> train_labels, test_labels;
+    generate(n_train, train_data, train_labels);
+    generate(n_test, test_data, test_labels);
+
+    const std::vector<std::pair<KNNClassifier::Precision, std::string>> modes = {
+        {KNNClassifier::Precision::Float64, "float64"},
+        {KNNClassifier::Precision::Float32, "float32"},
+        {KNNClassifier::Precision::UInt8, "uint8"}
+    };
+
+    double baseline_f1 = 0.0;
+    for (const auto& mode : modes) {
+        KNNClassifier knn;
+        knn.setPrecision(mode.first);
+        knn.setIndexType(KNNClassifier::IndexType::BruteForce);
+        knn.setBatchThreshold(0);  // сравнивается одно и то же ядро перебора
+        knn.fit(train_data, train_labels);
+
+        auto start = std::chrono::high_resolution_clock::now();
+        double f1 = knn.calculateF1Score(test_data, test_labels, 5);
+        auto end = std::chrono::high_resolution_clock::now();
+        double time_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+        if (mode.first == KNNClassifier::Precision::Float64) {
+            baseline_f1 = f1;
+        }
+        double memory_kb = knn.memoryFootprint() / 1024.0;
+
+        report << mode.second << "," << f1 << "," << f1 - baseline_f1 << ","
+               << memory_kb << "," << time_ms << "\n";
+        std::cout << "Precision: " << mode.second
+                  << ", F1 Score: " << std::fixed << std::setprecision(4) << f1
+                  << " (delta " << std::showpos << f1 - baseline_f1 << std::noshowpos << ")"
+                  << ", Memory: " << std::setprecision(1) << memory_kb << " KB"
+                  << ", Time: " << std::setprecision(3) << time_ms << " ms" << std::endl;
+    }
+
+    report.close();
+    std::cout << "Report saved to precision_performance.csv" << std::endl;
+}
+
+void performanceTestCrossValidation() {
+    std::cout << "\n=== KNN Cross-Validation k-Sweep Test ===" << std::endl;
+
+    std::ofstream report("cv_performance.csv");
+    report << "Metric,K,Mean_F1,Std_F1,Accuracy\n";
+
+    // Перекрывающиеся кластеры: качество заметно зависит от k
+    const int n_samples = 4000;
+    const int n_features = 20;
+    std::mt19937 gen(77);
+    std::uniform_real_distribution<> unit(0.0, 1.0);
+    std::normal_distribution<> noise(0.0, 0.35);
+    std::vector<std::vector<double>> centers(8, std::vector<double>(n_features));
+    for (auto& center : centers) {
+        for (auto& value : center) value = unit(gen);
+    }
+
+    auto table = std::make_shared<DataProcessor::FeatureTable>();
+    table->features = FeatureMatrix(n_samples, n_features);
+    table->label_names = {"Normal", "DoS", "Probe", "R2L"};
+    for (int i = 0; i < n_samples; ++i) {
+        size_t cluster = gen() % centers.size();
+        for (int j = 0; j < n_features; ++j) {
+            table->features.at(i, j) = centers[cluster][j] + noise(gen);
+        }
+        table->label_ids.push_back(static_cast<int32_t>(cluster % table->label_names.size()));
+    }
+
+    std::vector<size_t> ks;
+    for (size_t k = 1; k <= 31; k += 2) ks.push_back(k);
+    const size_t n_folds = 5;
+
+    // Прежний способ: отдельная оценка каждого k на каждом блоке
+    DataProcessor processor;
+    auto start = std::chrono::high_resolution_clock::now();
+    auto folds = processor.kFoldViews(table, n_folds, 42);
+    for (size_t k : ks) {
+        for (const auto& fold : folds) {
+            KNNClassifier knn;
+            knn.fit(fold.train);
+            knn.calculateF1Score(fold.test, static_cast<int>(k));
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    double naive_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+    CrossValidator validator;
+    validator.setFolds(n_folds);
+    validator.setSeed(42);
+    start = std::chrono::high_resolution_clock::now();
+    auto results = validator.run(table, ks, {CrossValidator::Metric::Euclidean});
+    end = std::chrono::high_resolution_clock::now();
+    double sweep_ms = std::chrono::duration<double, std::milli>(end - start).count();
+
+    auto other = validator.run(table, ks, {CrossValidator::Metric::Manhattan,
+                                           CrossValidator::Metric::Chebyshev});
+    results.insert(results.end(), other.begin(), other.end());
+
+    for (const auto& result : results) {
+        report << CrossValidator::metricName(result.metric) << "," << result.k << ","
+               << result.mean_f1 << "," << result.std_f1 << "," << result.accuracy << "\n";
+    }
+    const CrossValidator::Result* best = CrossValidator::best(results);
+
+    std::cout << "Folds: " << n_folds << ", k values: " << ks.size() << std::endl;
+    std::cout << "Per-k evaluation: " << std::fixed << std::setprecision(1) << naive_ms << " ms"
+              << ", single-pass sweep: " << sweep_ms << " ms"
+              << " (" << std::setprecision(2) << naive_ms / sweep_ms << "x)" << std::endl;
+    if (best) {
+        std::cout << "Best: k=" << best->k << ", metric=" << CrossValidator::metricName(best->metric)
+                  << ", F1=" << std::setprecision(4) << best->mean_f1
+                  << " +/- " << best->std_f1 << std::endl;
+    }
+
+    report.close();
+    std::cout << "Report saved to cv_performance.csv" << std::endl;
+}
+
+void performanceTestCSV() {
+    std::cout << "\n=== CSV Loading Performance Test ===" << std::endl;
+
+    std::ofstream report("csv_performance.csv");
+    report << "Loader,Rows,Size_MB,Time_ms,MB_per_s\n";
+
+    // Синтетический дамп трафика в формате KDD: 41 признак и метка
+    const int n_rows = 200000;
+    const int n_features = 41;
+    const std::string path = "csv_performance_data.csv";
+    {
+        std::ofstream out(path);
+        std::mt19937 gen(99);
+        std::uniform_real_distribution<> value(0.0, 1000.0);
+        const std::vector<std::string> classes = {"normal", "neptune", "smurf", "portsweep"};
+        for (int j = 0; j < n_features; ++j) out << "f" << j << ",";
+        out << "label\n";
+        out << std::setprecision(6);
+        for (int i = 0; i < n_rows; ++i) {
+            for (int j = 0; j < n_features; ++j) out << value(gen) << ",";
+            out << classes[gen() % classes.size()] << "\n";
+        }
+    }
+    std::ifstream probe(path, std::ios::binary | std::ios::ate);
+    double size_mb = probe.tellg() / (1024.0 * 1024.0);
+    probe.close();
+
+    auto record = [&](const std::string& name, size_t rows, double time_ms) {
+        report << name << "," << rows << "," << size_mb << "," << time_ms << ","
+               << size_mb / (time_ms / 1000.0) << "\n";
+        std::cout << "Loader: " << name << ", Rows: " << rows
+                  << ", Time: " << std::fixed << std::setprecision(1) << time_ms << " ms"
+                  << ", Throughput: " << size_mb / (time_ms / 1000.0) << " MB/s" << std::endl;
+    };
+
+    // Прежний способ: getline, stringstream на строку, std::stod
+    auto start = std::chrono::high_resolution_clock::now();
+    size_t reference_rows = 0;
+    {
+        std::ifstream file(path);
+        std::string line;
+        std::getline(file, line);
+        while (std::getline(file, line)) {
+            std::stringstream ss(line);
+            std::string cell;
+            std::vector<double> features;
+            while (std::getline(ss, cell, ',')) {
+                try {
+                    features.push_back(std::stod(cell));
+                } catch (...) {
+                    features.push_back(0.0);
+                }
+            }
+            ++reference_rows;
+        }
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    record("getline_stod", reference_rows,
+           std::chrono::duration<double, std::milli>(end - start).count());
+
+    DataProcessor processor;
+    for (size_t threads : {static_cast<size_t>(1), static_cast<size_t>(0)}) {
+        start = std::chrono::high_resolution_clock::now();
+        DataProcessor::FeatureTable table = processor.loadCSVTable(path, threads);
+        end = std::chrono::high_resolution_clock::now();
+        record(threads == 1 ? "mmap_from_chars_serial" : "mmap_from_chars_parallel",
+               table.features.rows(),
+               std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    // Первая загрузка записывает столбцовый кэш, вторая открывает его
+    for (const std::string name : {"cache_write", "cache_reopen"}) {
+        start = std::chrono::high_resolution_clock::now();
+        DataProcessor::FeatureTable table = processor.loadDataset(path);
+        end = std::chrono::high_resolution_clock::now();
+        record(name, table.features.rows(),
+               std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    std::remove(path.c_str());
+    std::remove((path + ".cols").c_str());
+    report.close();
+    std::cout << "Report saved to csv_performance.csv" << std::endl;
+}
+
 void performanceTestBlowfish() {
     std::cout << "\n=== Blowfish Performance Test ===" << std::endl;
+    std::cout << std::defaultfloat << std::setprecision(6);
     
     std::ofstream report("blowfish_performance.csv");
-    report << "PacketSize,EncryptionTime_ms,DecryptionTime_ms,TotalTime_ms\n";
+    report << "PacketSize,EncryptionTime_ms,DecryptionTime_ms,TotalTime_ms,"
+              "InPlaceEnc_ms,InPlaceDec_ms,InPlaceTotal_ms,"
+              "BatchLoop_ms,Batch_ms\n";
     
     Blowfish blowfish;
     std::vector<uint8_t> key(16, 0x42);
     blowfish.setKey(key);
     
     std::vector<int> packet_sizes = {64, 128, 256, 512, 1024, 2048};
+    // Время одного пакета мало, поэтому берется среднее по повторам
+    const int repeats = 2000;
+    const size_t batch_size = 1024;
     
     std::random_device rd;
     std::mt19937 gen(rd());
@@ -178,22 +540,69 @@ void performanceTestBlowfish() {
             packet[i] = static_cast<uint8_t>(byte_dist(gen));
         }
         
-        // Измерение времени шифрования
+        // Векторный API: выделение памяти на каждый пакет
+        std::vector<uint8_t> encrypted, decrypted;
         auto start_enc = std::chrono::high_resolution_clock::now();
-        auto encrypted = blowfish.encrypt(packet);
+        for (int r = 0; r < repeats; ++r) {
+            encrypted = blowfish.encrypt(packet);
+        }
         auto end_enc = std::chrono::high_resolution_clock::now();
         
-        // Измерение времени дешифрования
         auto start_dec = std::chrono::high_resolution_clock::now();
-        auto decrypted = blowfish.decrypt(encrypted);
+        for (int r = 0; r < repeats; ++r) {
+            decrypted = blowfish.decrypt(encrypted);
+        }
         auto end_dec = std::chrono::high_resolution_clock::now();
         
-        auto enc_time = std::chrono::duration<double, std::milli>(end_enc - start_enc);
-        auto dec_time = std::chrono::duration<double, std::milli>(end_dec - start_dec);
+        // Буферный API: одни и те же буферы на все повторы
+        std::vector<uint8_t> cipher_buffer(Blowfish::paddedSize(packet.size()));
+        std::vector<uint8_t> plain_buffer(cipher_buffer.size());
+        size_t cipher_length = 0, plain_length = 0;
+        bool in_place_ok = true;
+        auto start_buf_enc = std::chrono::high_resolution_clock::now();
+        for (int r = 0; r < repeats; ++r) {
+            blowfish.encrypt(packet.data(), packet.size(), cipher_buffer.data(),
+                             cipher_buffer.size(), cipher_length);
+        }
+        auto end_buf_enc = std::chrono::high_resolution_clock::now();
+        for (int r = 0; r < repeats; ++r) {
+            in_place_ok &= blowfish.decrypt(cipher_buffer.data(), cipher_length,
+                                            plain_buffer.data(), plain_length);
+        }
+        auto end_buf_dec = std::chrono::high_resolution_clock::now();
+        double in_place_enc =
+            std::chrono::duration<double, std::milli>(end_buf_enc - start_buf_enc).count() / repeats;
+        double in_place_dec =
+            std::chrono::duration<double, std::milli>(end_buf_dec - end_buf_enc).count() / repeats;
+        in_place_ok = in_place_ok && plain_length == packet.size() &&
+                      std::equal(packet.begin(), packet.end(), plain_buffer.begin());
+        
+        // Пакет из batch_size пакетов: поштучный CTR и один вызов ctrPackets
+        std::vector<uint8_t> batch_in(batch_size * packet.size()), batch_out(batch_in.size());
+        for (size_t i = 0; i < batch_in.size(); ++i) batch_in[i] = packet[i % packet.size()];
+        std::vector<BlowfishPacket> batch(batch_size);
+        for (size_t p = 0; p < batch_size; ++p) {
+            batch[p] = {batch_in.data() + p * packet.size(), batch_out.data() + p * packet.size(),
+                        packet.size(), p << 32};
+        }
+        auto start_loop = std::chrono::high_resolution_clock::now();
+        for (const BlowfishPacket& item : batch) {
+            blowfish.ctr(item.in, item.length, item.out, item.iv);
+        }
+        auto end_loop = std::chrono::high_resolution_clock::now();
+        blowfish.ctrPackets(batch);
+        auto end_batch = std::chrono::high_resolution_clock::now();
+        double loop_ms = std::chrono::duration<double, std::milli>(end_loop - start_loop).count();
+        double batch_ms = std::chrono::duration<double, std::milli>(end_batch - end_loop).count();
+        
+        auto enc_time = std::chrono::duration<double, std::milli>(end_enc - start_enc) / repeats;
+        auto dec_time = std::chrono::duration<double, std::milli>(end_dec - start_dec) / repeats;
         auto total_time = enc_time + dec_time;
         
         report << size << "," << enc_time.count() << "," 
-               << dec_time.count() << "," << total_time.count() << "\n";
+               << dec_time.count() << "," << total_time.count() << ","
+               << in_place_enc << "," << in_place_dec << ","
+               << in_place_enc + in_place_dec << "," << loop_ms << "," << batch_ms << "\n";
         
         std::cout << "Packet: " << size << " bytes, "
                   << "Enc: " << enc_time.count() << " ms, "
@@ -201,18 +610,286 @@ void performanceTestBlowfish() {
                   << "Total: " << total_time.count() << " ms" 
                   << " (Requirement: " << (total_time.count() < 1.0 ? "PASS" : "FAIL") << ")" 
                   << std::endl;
+        std::cout << "  In-place: Enc: " << in_place_enc << " ms, Dec: " << in_place_dec
+                  << " ms, Total: " << in_place_enc + in_place_dec << " ms" << std::endl;
+        std::cout << "  Batch of " << batch_size << " (CTR): per-packet " << loop_ms
+                  << " ms, ctrPackets " << batch_ms << " ms (Requirement: "
+                  << (batch_ms < 1.0 ? "PASS" : "FAIL") << ")" << std::endl;
         
         // Проверка целостности
-        bool success = (packet == decrypted);
+        bool success = (packet == decrypted) && in_place_ok;
         if (!success) {
             std::cout << "WARNING: Decryption failed for packet size " << size << std::endl;
         }
     }
     
+    // Пропускная способность на большом буфере: по одному блоку
+    // и пакетными ядрами encryptBlocks (скалярное и SIMD), ECB и CTR
+    std::vector<uint8_t> bulk(1 << 20);
+    for (auto& byte : bulk) byte = static_cast<uint8_t>(byte_dist(gen));
+    const BlowfishContext& context = *blowfish.context();
+    auto start_single = std::chrono::high_resolution_clock::now();
+    for (size_t i = 0; i < bulk.size(); i += Blowfish::BLOCK_SIZE) {
+        uint32_t halves[2];
+        std::memcpy(halves, bulk.data() + i, sizeof(halves));
+        context.encryptBlock(halves[0], halves[1]);
+        std::memcpy(bulk.data() + i, halves, sizeof(halves));
+    }
+    auto end_single = std::chrono::high_resolution_clock::now();
+    double gb = bulk.size() / 1e9;
+    double single_s = std::chrono::duration<double>(end_single - start_single).count();
+    std::cout << "Throughput (1 MiB, 1 thread): single-block " << gb / single_s << " GB/s"
+              << std::endl;
+    
+    blowfish.setNumThreads(1);
+    double scalar_ecb = 0.0;
+    for (BlowfishSimd level : {BlowfishSimd::Scalar, BlowfishSimd::AVX2, BlowfishSimd::AVX512}) {
+        if (blowfishKernelsFor(level).level != level) {
+            continue;   // уровень не поддерживается процессором
+        }
+        blowfish.setSimdLevel(level);
+        auto t0 = std::chrono::high_resolution_clock::now();
+        for (int r = 0; r < 8; ++r) blowfish.encryptBlocks(bulk.data(), bulk.size());
+        auto t1 = std::chrono::high_resolution_clock::now();
+        for (int r = 0; r < 8; ++r) blowfish.ctr(bulk.data(), bulk.size(), bulk.data(), r);
+        auto t2 = std::chrono::high_resolution_clock::now();
+        double ecb = 8 * gb / std::chrono::duration<double>(t1 - t0).count();
+        double ctr = 8 * gb / std::chrono::duration<double>(t2 - t1).count();
+        if (level == BlowfishSimd::Scalar) scalar_ecb = ecb;
+        std::cout << "  kernel " << blowfish.simdName() << ": ECB " << ecb << " GB/s, CTR "
+                  << ctr << " GB/s (" << ecb / scalar_ecb << "x scalar)" << std::endl;
+    }
+    blowfish.setSimdLevel(detectBlowfishSimd());
+    blowfish.setNumThreads(0);
+    
+    // CTR и расшифровка CBC на большом архиве: один поток и общий пул
+    std::vector<uint8_t> archive(16 << 20);
+    for (size_t i = 0; i < archive.size(); ++i) archive[i] = static_cast<uint8_t>(i * 131);
+    std::vector<uint8_t> archive_out(Blowfish::paddedSize(archive.size()));
+    const uint64_t iv = 0x0123456789ABCDEFULL;
+    double archive_mb = archive.size() / (1024.0 * 1024.0);
+    for (size_t threads : {size_t(1), size_t(0)}) {
+        blowfish.setNumThreads(threads);
+        auto t0 = std::chrono::high_resolution_clock::now();
+        blowfish.ctr(archive.data(), archive.size(), archive_out.data(), iv);
+        auto t1 = std::chrono::high_resolution_clock::now();
+        size_t cipher_length = 0, plain_length = 0;
+        blowfish.encryptCBC(archive.data(), archive.size(), archive_out.data(),
+                            archive_out.size(), cipher_length, iv);
+        auto t2 = std::chrono::high_resolution_clock::now();
+        blowfish.decryptCBC(archive_out.data(), cipher_length, archive_out.data(),
+                            plain_length, iv);
+        auto t3 = std::chrono::high_resolution_clock::now();
+        std::cout << "16 MiB, " << (threads == 1 ? std::string("1 thread")
+                                                 : std::to_string(ThreadPool::shared().size()) +
+                                                       " pool threads")
+                  << ": CTR " << archive_mb / std::chrono::duration<double>(t1 - t0).count()
+                  << " MB/s, CBC enc "
+                  << archive_mb / std::chrono::duration<double>(t2 - t1).count()
+                  << " MB/s, CBC dec "
+                  << archive_mb / std::chrono::duration<double>(t3 - t2).count() << " MB/s"
+                  << std::endl;
+    }
+    blowfish.setNumThreads(0);
+    
+    // Тот же архив потоком кусками по 64 КиБ: память постоянна
+    for (BlowfishMode mode : {BlowfishMode::CTR, BlowfishMode::CBC}) {
+        BlowfishEncryptor encryptor(blowfish.context(), mode, iv);
+        std::vector<uint8_t> chunk_out(64 * 1024 + Blowfish::BLOCK_SIZE);
+        size_t written = 0, total_written = 0;
+        auto t0 = std::chrono::high_resolution_clock::now();
+        for (size_t pos = 0; pos < archive.size(); pos += 64 * 1024) {
+            size_t n = std::min<size_t>(64 * 1024, archive.size() - pos);
+            encryptor.update(archive.data() + pos, n, chunk_out.data(), chunk_out.size(), written);
+            total_written += written;
+        }
+        encryptor.finalize(chunk_out.data(), chunk_out.size(), written);
+        total_written += written;
+        auto t1 = std::chrono::high_resolution_clock::now();
+        std::cout << "16 MiB streamed in 64 KiB chunks, "
+                  << (mode == BlowfishMode::CTR ? "CTR" : "CBC") << ": "
+                  << archive_mb / std::chrono::duration<double>(t1 - t0).count() << " MB/s, "
+                  << total_written << " bytes out" << std::endl;
+    }
+    
+    // Развертка ключей на поток: каждый раз заново и через кэш контекстов
+    const int flows = 1000;
+    std::vector<std::vector<uint8_t>> flow_keys(flows, std::vector<uint8_t>(16));
+    for (auto& flow_key : flow_keys) {
+        for (auto& byte : flow_key) byte = static_cast<uint8_t>(byte_dist(gen));
+    }
+    auto start_expand = std::chrono::high_resolution_clock::now();
+    for (const auto& flow_key : flow_keys) {
+        blowfish.setKey(flow_key);
+    }
+    auto end_expand = std::chrono::high_resolution_clock::now();
+    BlowfishKeyCache key_cache(flows);
+    for (int i = 0; i < flows; ++i) key_cache.get(i, flow_keys[i]);
+    auto start_cached = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < flows; ++i) {
+        blowfish.setContext(key_cache.get(i, flow_keys[i]));
+    }
+    auto end_cached = std::chrono::high_resolution_clock::now();
+    std::cout << "Key setup per flow: "
+              << std::chrono::duration<double, std::micro>(end_expand - start_expand).count() / flows
+              << " us expanded, "
+              << std::chrono::duration<double, std::micro>(end_cached - start_cached).count() / flows
+              << " us cached" << std::endl;
+    
     report.close();
     std::cout << "Report saved to blowfish_performance.csv" << std::endl;
 }
 
+// Формат зашифрованного файла: 8 байт сигнатуры, 8 байт начального
+// счетчика CTR (big-endian), затем шифротекст той же длины, что и файл
+const char FILE_MAGIC[8] = {'B', 'F', 'C', 'T', 'R', 'v', '0', '1'};
+const size_t FILE_HEADER_SIZE = 16;
+// Отрезок файла, который шифрует одна задача пула
+const size_t FILE_SEGMENT_SIZE = 8 << 20;
+
+// Счетчики страничных отказов процесса: {minor, major}
+std::pair<long, long> pageFaults() {
+#ifdef HAS_RUSAGE
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        return {usage.ru_minflt, usage.ru_majflt};
+    }
+#endif
+    return {0, 0};
+}
+
+bool parseHexKey(const std::string& hex, std::vector<uint8_t>& key) {
+    if (hex.empty() || hex.size() % 2 != 0) return false;
+    key.clear();
+    for (size_t i = 0; i < hex.size(); i += 2) {
+        unsigned value = 0;
+        if (std::sscanf(hex.c_str() + i, "%2x", &value) != 1 ||
+            !std::isxdigit(static_cast<unsigned char>(hex[i])) ||
+            !std::isxdigit(static_cast<unsigned char>(hex[i + 1]))) {
+            return false;
+        }
+        key.push_back(static_cast<uint8_t>(value));
+    }
+    return true;
+}
+
+// Предел --threads: больше потоков, чем несколько на ядро, не ускоряет
+// шифрование, а очень большое число не удается создать вовсе
+size_t maxFileThreads() {
+    return 4 * std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Неотрицательное целое без знака, пробелов и лишних символов
+bool parseCount(const std::string& text, size_t& value) {
+    const char* end = text.data() + text.size();
+    auto result = std::from_chars(text.data(), end, value);
+    return !text.empty() && result.ec == std::errc() && result.ptr == end;
+}
+
+// Шифрование (CTR) файла через отображение в память: вход и выход
+// отображаются целиком, файл делится на отрезки по FILE_SEGMENT_SIZE,
+// каждый отрезок шифруется в своей задаче пула со своим диапазоном счетчика
+int runFileCipher(bool encrypt, const std::string& input_path, const std::string& output_path,
+                  const std::vector<uint8_t>& key, size_t num_threads) {
+    std::cout << "\n=== Blowfish File " << (encrypt ? "Encryption" : "Decryption")
+              << " (CTR, mmap) ===" << std::endl;
+
+    Blowfish blowfish;
+    if (!blowfish.setKey(key)) return 1;
+    blowfish.setNumThreads(1);   // параллельность - по отрезкам файла
+
+    auto faults_before = pageFaults();
+    auto start = std::chrono::high_resolution_clock::now();
+
+    // Выходной файл усекается при создании: если это тот же файл, что и
+    // входной, чтение его отображения завершится SIGBUS
+    std::error_code same_error;
+    if (std::filesystem::equivalent(input_path, output_path, same_error)) {
+        std::cerr << "Ошибка: " << input_path << " и " << output_path
+                  << " - один и тот же файл" << std::endl;
+        return 1;
+    }
+
+    auto input = MappedFile::open(input_path);
+    if (!input) {
+        std::cerr << "Ошибка: не удалось открыть " << input_path << std::endl;
+        return 1;
+    }
+    input->adviseSequential();
+
+    uint64_t iv = 0;
+    const uint8_t* source = input->data();
+    size_t length = input->size();
+    size_t output_size = length + FILE_HEADER_SIZE;
+    if (!encrypt) {
+        if (length < FILE_HEADER_SIZE || std::memcmp(source, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0) {
+            std::cerr << "Ошибка: " << input_path << " не является зашифрованным файлом" << std::endl;
+            return 1;
+        }
+        for (size_t i = 0; i < 8; ++i) iv = (iv << 8) | source[8 + i];
+        source += FILE_HEADER_SIZE;
+        length -= FILE_HEADER_SIZE;
+        output_size = length;
+    } else {
+        std::random_device rd;
+        iv = (static_cast<uint64_t>(rd()) << 32) | rd();
+    }
+
+    auto output = MappedFile::create(output_path, output_size);
+    if (!output) {
+        std::cerr << "Ошибка: не удалось создать " << output_path << std::endl;
+        return 1;
+    }
+    output->adviseSequential();
+    uint8_t* target = output->mutableData();
+    if (encrypt) {
+        std::memcpy(target, FILE_MAGIC, sizeof(FILE_MAGIC));
+        for (size_t i = 0; i < 8; ++i) target[8 + i] = static_cast<uint8_t>(iv >> (56 - 8 * i));
+        target += FILE_HEADER_SIZE;
+    }
+
+    // 0 - общий пул, 1 - последовательно, n - свой пул из n потоков
+    std::unique_ptr<ThreadPool> own_pool;
+    ThreadPool* pool = nullptr;
+    if (num_threads == 0) {
+        pool = &ThreadPool::shared();
+    } else if (num_threads > 1) {
+        own_pool.reset(new ThreadPool(num_threads));
+        pool = own_pool.get();
+    }
+    size_t segments = (length + FILE_SEGMENT_SIZE - 1) / FILE_SEGMENT_SIZE;
+    auto encryptSegments = [&](size_t begin, size_t end) {
+        for (size_t s = begin; s < end; ++s) {
+            size_t offset = s * FILE_SEGMENT_SIZE;
+            size_t n = std::min(FILE_SEGMENT_SIZE, length - offset);
+            blowfish.ctr(source + offset, n, target + offset, iv, offset);
+        }
+    };
+    if (pool) {
+        pool->parallelFor(0, segments, 1, encryptSegments);
+    } else {
+        encryptSegments(0, segments);
+    }
+
+    // Отображения закрываются до замера: запись в файл - часть работы
+    output.reset();
+    input.reset();
+    auto end = std::chrono::high_resolution_clock::now();
+    auto faults_after = pageFaults();
+
+    double seconds = std::chrono::duration<double>(end - start).count();
+    size_t threads_used = pool ? pool->size() : 1;
+    std::cout << "Input: " << input_path << " -> " << output_path << std::endl;
+    std::cout << "Bytes: " << length << ", segments: " << segments << " x "
+              << (FILE_SEGMENT_SIZE >> 20) << " MiB, threads: " << threads_used
+              << ", kernel: " << blowfish.simdName() << std::endl;
+    std::cout << "Time: " << seconds * 1000.0 << " ms, throughput: "
+              << (seconds > 0 ? length / seconds / (1024.0 * 1024.0) : 0.0) << " MB/s" << std::endl;
+    std::cout << "Page faults: minor " << faults_after.first - faults_before.first
+              << ", major " << faults_after.second - faults_before.second << std::endl;
+    return 0;
+}
+
 int main(int argc, char* argv[]) {
     std::cout << "================================================" << std::endl;
     std::cout << "   Network Security Analysis System" << std::endl;
@@ -229,18 +906,52 @@ int main(int argc, char* argv[]) {
             runSimpleBlowfishTests();
         } else if (command == "--performance") {
             performanceTestKNN();
+            performanceTestANN();
+            performanceTestPrecision();
+            performanceTestCrossValidation();
+            performanceTestCSV();
             performanceTestBlowfish();
         } else if (command == "--all") {
             runSimpleKNNTests();
             runSimpleBlowfishTests();
             performanceTestKNN();
+            performanceTestANN();
+            performanceTestPrecision();
+            performanceTestCrossValidation();
+            performanceTestCSV();
             performanceTestBlowfish();
+        } else if (command == "--encrypt-file" || command == "--decrypt-file") {
+            // IN OUT --key HEX [--threads N]; N = 0 - по числу ядер
+            std::vector<uint8_t> key;
+            size_t threads = 0;
+            bool valid = argc >= 4;
+            for (int i = 4; valid && i < argc; ++i) {
+                std::string option = argv[i];
+                if (option == "--key" && i + 1 < argc) {
+                    valid = parseHexKey(argv[++i], key);
+                } else if (option == "--threads" && i + 1 < argc) {
+                    valid = parseCount(argv[++i], threads) && threads <= maxFileThreads();
+                } else {
+                    valid = false;
+                }
+            }
+            if (!valid || key.empty()) {
+                std::cerr << "Usage: " << argv[0] << " " << command
+                          << " IN OUT --key HEX [--threads N]" << std::endl;
+                std::cerr << "  N: 0 (all cores) .. " << maxFileThreads() << std::endl;
+                return 1;
+            }
+            return runFileCipher(command == "--encrypt-file", argv[2], argv[3], key, threads);
         } else if (command == "--help") {
             std::cout << "\nUsage: " << argv[0] << " [option]\n";
             std::cout << "Options:\n";
             std::cout << "  --simple       Run simple demonstration tests\n";
             std::cout << "  --performance  Run performance tests with reports\n";
             std::cout << "  --all          Run all tests\n";
+            std::cout << "  --encrypt-file IN OUT --key HEX [--threads N]\n";
+            std::cout << "                 Encrypt a file (Blowfish CTR, mmap, multithreaded)\n";
+            std::cout << "  --decrypt-file IN OUT --key HEX [--threads N]\n";
+            std::cout << "                 Decrypt a file produced by --encrypt-file\n";
             std::cout << "  --help         Show this help message\n";
             std::cout << "  (no args)      Run demonstration\n";
         }
@@ -0,0 +1,133 @@
+#include "classification_metrics.h"
+#include <iomanip>
+#include <algorithm>
+
+namespace {
+
+double ratio(uint64_t numerator, uint64_t denominator) {
+    return denominator > 0 ? static_cast<double>(numerator) / denominator : 0.0;
+}
+
+double harmonic(double precision, double recall) {
+    return (precision + recall > 0) ? 2 * precision * recall / (precision + recall) : 0.0;
+}
+
+} // namespace
+
+ConfusionMatrix::ConfusionMatrix(size_t n_classes)
+    : n_classes(n_classes), counts(n_classes * n_classes, 0), unknown_actual(n_classes, 0),
+      active(n_classes, 1), total(0), unpredicted(0) {}
+
+void ConfusionMatrix::merge(const ConfusionMatrix& other) {
+    for (size_t i = 0; i < counts.size() && i < other.counts.size(); ++i) {
+        counts[i] += other.counts[i];
+    }
+    for (size_t c = 0; c < unknown_actual.size() && c < other.unknown_actual.size(); ++c) {
+        unknown_actual[c] += other.unknown_actual[c];
+    }
+    total += other.total;
+    unpredicted += other.unpredicted;
+}
+
+ConfusionMatrix::ClassStats ConfusionMatrix::classStats(size_t class_id) const {
+    ClassStats stats = {0.0, 0.0, 0.0, 0, unknown_actual[class_id], counts[class_id * n_classes + class_id]};
+    for (size_t other = 0; other < n_classes; ++other) {
+        stats.support += counts[class_id * n_classes + other];
+        stats.predicted += counts[other * n_classes + class_id];
+    }
+    stats.precision = ratio(stats.true_positives, stats.predicted);
+    stats.recall = ratio(stats.true_positives, stats.support);
+    stats.f1 = harmonic(stats.precision, stats.recall);
+    return stats;
+}
+
+double ConfusionMatrix::accuracy() const {
+    uint64_t correct = 0;
+    for (size_t c = 0; c < n_classes; ++c) {
+        correct += counts[c * n_classes + c];
+    }
+    return ratio(correct, total);
+}
+
+double ConfusionMatrix::microF1() const {
+    uint64_t correct = 0;
+    for (size_t c = 0; c < n_classes; ++c) {
+        correct += counts[c * n_classes + c];
+    }
+    double precision = ratio(correct, total - unpredicted);
+    double recall = ratio(correct, total);
+    return harmonic(precision, recall);
+}
+
+double ConfusionMatrix::macroPrecision() const {
+    double sum = 0.0;
+    size_t used = 0;
+    for (size_t c = 0; c < n_classes; ++c) {
+        if (!active[c]) continue;
+        sum += classStats(c).precision;
+        ++used;
+    }
+    return used > 0 ? sum / used : 0.0;
+}
+
+double ConfusionMatrix::macroRecall() const {
+    double sum = 0.0;
+    size_t used = 0;
+    for (size_t c = 0; c < n_classes; ++c) {
+        if (!active[c]) continue;
+        sum += classStats(c).recall;
+        ++used;
+    }
+    return used > 0 ? sum / used : 0.0;
+}
+
+double ConfusionMatrix::macroF1() const {
+    double sum = 0.0;
+    size_t used = 0;
+    for (size_t c = 0; c < n_classes; ++c) {
+        if (!active[c]) continue;
+        sum += classStats(c).f1;
+        ++used;
+    }
+    return used > 0 ? sum / used : 0.0;
+}
+
+double ConfusionMatrix::weightedF1() const {
+    double sum = 0.0;
+    uint64_t weight = 0;
+    for (size_t c = 0; c < n_classes; ++c) {
+        if (!active[c]) continue;
+        ClassStats stats = classStats(c);
+        sum += stats.f1 * stats.support;
+        weight += stats.support;
+    }
+    return weight > 0 ? sum / weight : 0.0;
+}
+
+void ConfusionMatrix::print(std::ostream& out, const std::vector<std::string>& class_names) const {
+    size_t width = 12;
+    for (const auto& name : class_names) width = std::max(width, name.size() + 2);
+
+    std::ios_base::fmtflags flags = out.flags();
+    std::streamsize precision = out.precision();
+    out << std::left << std::setw(width) << "class" << std::right
+        << std::setw(11) << "precision" << std::setw(9) << "recall"
+        << std::setw(9) << "f1" << std::setw(10) << "support" << "\n";
+    out << std::fixed << std::setprecision(4);
+    for (size_t c = 0; c < n_classes; ++c) {
+        if (!active[c]) continue;
+        ClassStats stats = classStats(c);
+        out << std::left << std::setw(width) << (c < class_names.size() ? class_names[c] : std::to_string(c))
+            << std::right << std::setw(11) << stats.precision << std::setw(9) << stats.recall
+            << std::setw(9) << stats.f1 << std::setw(10) << stats.support << "\n";
+    }
+    out << std::left << std::setw(width) << "accuracy" << std::right
+        << std::setw(29) << accuracy() << std::setw(10) << total << "\n";
+    out << std::left << std::setw(width) << "macro avg" << std::right
+        << std::setw(11) << macroPrecision() << std::setw(9) << macroRecall()
+        << std::setw(9) << macroF1() << "\n";
+    out << std::left << std::setw(width) << "weighted avg" << std::right
+        << std::setw(29) << weightedF1() << "\n";
+    out.flags(flags);
+    out.precision(precision);
+}
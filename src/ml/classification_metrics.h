@@ -0,0 +1,72 @@
+#ifndef CLASSIFICATION_METRICS_H
+#define CLASSIFICATION_METRICS_H
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <cstdint>
+#include <cstddef>
+
+// Плотная матрица ошибок по целочисленным номерам классов: строка -
+// фактический класс, столбец - предсказанный. Все метрики считаются из
+// нее без обращения к строковым меткам. Фактический класс -1 (метка,
+// неизвестная модели) учитывается только как ложное срабатывание
+// предсказанного класса.
+class ConfusionMatrix {
+public:
+    struct ClassStats {
+        double precision;
+        double recall;
+        double f1;
+        uint64_t support;        // строк с этим фактическим классом
+        uint64_t predicted;      // строк с этим предсказанием
+        uint64_t true_positives;
+    };
+
+private:
+    size_t n_classes;
+    std::vector<uint64_t> counts;           // n_classes x n_classes
+    std::vector<uint64_t> unknown_actual;   // предсказания для неизвестных меток
+    std::vector<char> active;               // классы, входящие в усреднение
+    uint64_t total;
+    uint64_t unpredicted;                   // строк без предсказания (-1)
+
+public:
+    explicit ConfusionMatrix(size_t n_classes = 0);
+
+    void add(int actual, int predicted) {
+        ++total;
+        if (predicted < 0 || static_cast<size_t>(predicted) >= n_classes) {
+            ++unpredicted;
+        } else if (actual < 0 || static_cast<size_t>(actual) >= n_classes) {
+            unknown_actual[predicted]++;
+        } else {
+            counts[static_cast<size_t>(actual) * n_classes + predicted]++;
+        }
+    }
+    // Сложение матриц, посчитанных разными потоками
+    void merge(const ConfusionMatrix& other);
+
+    // Усреднение macro/weighted идет по активным классам (по умолчанию - по всем);
+    // классы, которых не было при обучении, обычно исключаются
+    void setActive(size_t class_id, bool enabled) { active[class_id] = enabled ? 1 : 0; }
+
+    size_t size() const { return n_classes; }
+    uint64_t totalCount() const { return total; }
+    uint64_t count(size_t actual, size_t predicted) const { return counts[actual * n_classes + predicted]; }
+
+    ClassStats classStats(size_t class_id) const;
+    double accuracy() const;
+    // Micro-F1 по всем строкам; при предсказании для каждой строки равен accuracy
+    double microF1() const;
+    double macroPrecision() const;
+    double macroRecall() const;
+    double macroF1() const;
+    // Среднее F1 с весами по support
+    double weightedF1() const;
+
+    // Отчет по классам в духе classification_report
+    void print(std::ostream& out, const std::vector<std::string>& class_names) const;
+};
+
+#endif
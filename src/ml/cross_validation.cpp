@@ -0,0 +1,203 @@
+#include "cross_validation.h"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Рабочие буферы одного потока
+struct SweepScratch {
+    std::vector<Neighbour> neighbours;
+    TopK heap;
+    std::vector<int> votes;
+    std::vector<size_t> first_rank;
+};
+
+SweepScratch& sweepScratch() {
+    static thread_local SweepScratch scratch;
+    return scratch;
+}
+
+double metricDistance(CrossValidator::Metric metric, const double* a, const double* b, size_t n) {
+    double result = 0.0;
+    if (metric == CrossValidator::Metric::Manhattan) {
+        for (size_t j = 0; j < n; ++j) result += std::abs(a[j] - b[j]);
+    } else {
+        for (size_t j = 0; j < n; ++j) result = std::max(result, std::abs(a[j] - b[j]));
+    }
+    return result;
+}
+
+} // namespace
+
+CrossValidator::CrossValidator()
+    : n_folds(5), seed(42), stratified(true), index_type(KNNClassifier::IndexType::Auto),
+      num_threads(0) {}
+
+void CrossValidator::setNumThreads(size_t n) {
+    num_threads = n;
+    own_pool.reset();
+    if (n > 1) {
+        own_pool = std::make_shared<ThreadPool>(n);
+    }
+}
+
+ThreadPool* CrossValidator::pool() {
+    if (num_threads == 1) return nullptr;
+    if (own_pool) return own_pool.get();
+    return &ThreadPool::shared();
+}
+
+const char* CrossValidator::metricName(Metric metric) {
+    switch (metric) {
+        case Metric::Euclidean: return "euclidean";
+        case Metric::Manhattan: return "manhattan";
+        case Metric::Chebyshev: return "chebyshev";
+    }
+    return "unknown";
+}
+
+std::vector<CrossValidator::Result> CrossValidator::run(
+    const std::shared_ptr<const DataProcessor::FeatureTable>& table,
+    const std::vector<size_t>& ks, const std::vector<Metric>& metrics) {
+    std::vector<Result> results;
+    std::vector<size_t> sorted_ks;
+    for (size_t k : ks) {
+        if (k > 0) sorted_ks.push_back(k);
+    }
+    std::sort(sorted_ks.begin(), sorted_ks.end());
+    sorted_ks.erase(std::unique(sorted_ks.begin(), sorted_ks.end()), sorted_ks.end());
+    if (!table || sorted_ks.empty()) return results;
+
+    DataProcessor processor;
+    std::vector<DataProcessor::Fold> folds = processor.kFoldViews(table, n_folds, seed, stratified);
+    if (folds.empty()) return results;
+
+    const size_t max_k = sorted_ks.back();
+    const size_t n_labels = table->label_names.size();
+    const size_t n_cols = table->features.cols();
+    ThreadPool* workers = pool();
+
+    // Тестовые строки всех блоков нумеруются подряд
+    std::vector<size_t> query_offsets = {0};
+    for (const auto& fold : folds) {
+        query_offsets.push_back(query_offsets.back() + fold.test.size());
+    }
+    const size_t n_queries = query_offsets.back();
+
+    for (Metric metric : metrics) {
+        // Модели блоков для евклидовой метрики обучаются параллельно
+        std::vector<KNNClassifier> models(metric == Metric::Euclidean ? folds.size() : 0);
+        auto fit_body = [&](size_t begin, size_t end) {
+            for (size_t f = begin; f < end; ++f) {
+                models[f].setNumThreads(1);
+                models[f].setBatchThreshold(0);
+                models[f].setIndexType(index_type);
+                models[f].fit(folds[f].train);
+            }
+        };
+        if (workers && models.size() > 1) {
+            workers->parallelFor(0, models.size(), 1, fit_body);
+        } else {
+            fit_body(0, models.size());
+        }
+
+        // predictions[ki * n_queries + q] - метка, предсказанная при k = sorted_ks[ki]
+        std::vector<int32_t> predictions(sorted_ks.size() * n_queries, -1);
+        auto query_body = [&](size_t begin, size_t end) {
+            SweepScratch& scratch = sweepScratch();
+            for (size_t q = begin; q < end; ++q) {
+                size_t f = std::upper_bound(query_offsets.begin(), query_offsets.end(), q) -
+                           query_offsets.begin() - 1;
+                const DataProcessor::Fold& fold = folds[f];
+                const double* query = fold.test.features(q - query_offsets[f]);
+
+                // Соседи ищутся один раз, для наибольшего k
+                if (metric == Metric::Euclidean) {
+                    models[f].findNeighbours(query, n_cols, static_cast<int>(max_k), scratch.neighbours);
+                } else {
+                    scratch.heap.reset(max_k);
+                    for (size_t r = 0; r < fold.train.size(); ++r) {
+                        double d = metricDistance(metric, query, fold.train.features(r), n_cols);
+                        if (!scratch.heap.full() || d <= scratch.heap.bound()) {
+                            scratch.heap.push(d, r);
+                        }
+                    }
+                    scratch.heap.sortedInto(scratch.neighbours);
+                }
+
+                // Голосование по префиксам: при равенстве голосов побеждает
+                // метка, чей представитель ближе (как в KNNClassifier)
+                scratch.votes.assign(n_labels, 0);
+                scratch.first_rank.assign(n_labels, 0);
+                int best = -1;
+                size_t ki = 0;
+                for (size_t i = 0; i < scratch.neighbours.size() && ki < sorted_ks.size(); ++i) {
+                    int label = fold.train.labelId(scratch.neighbours[i].index);
+                    if (scratch.votes[label]++ == 0) scratch.first_rank[label] = i;
+                    if (best < 0 || scratch.votes[label] > scratch.votes[best] ||
+                        (scratch.votes[label] == scratch.votes[best] &&
+                         scratch.first_rank[label] < scratch.first_rank[best])) {
+                        best = label;
+                    }
+                    while (ki < sorted_ks.size() && sorted_ks[ki] == i + 1) {
+                        predictions[ki++ * n_queries + q] = best;
+                    }
+                }
+                // k больше обучающей части: голосуют все ее строки
+                for (; ki < sorted_ks.size(); ++ki) {
+                    predictions[ki * n_queries + q] = best;
+                }
+            }
+        };
+        if (workers && n_queries > 1) {
+            size_t grain = std::max<size_t>(1, n_queries / ((workers->size() + 1) * 8));
+            workers->parallelFor(0, n_queries, grain, query_body);
+        } else {
+            query_body(0, n_queries);
+        }
+
+        // Метрики по блокам
+        for (size_t ki = 0; ki < sorted_ks.size(); ++ki) {
+            Result result = {metric, sorted_ks[ki], 0.0, 0.0, 0.0, {}};
+            ConfusionMatrix all_folds(n_labels);
+            for (size_t f = 0; f < folds.size(); ++f) {
+                const DataProcessor::Fold& fold = folds[f];
+                // Метки, которых нет в обучающей части, для модели блока
+                // неизвестны: в усреднение не входят и считаются как -1
+                std::vector<char> trained(n_labels, 0);
+                for (size_t r = 0; r < fold.train.size(); ++r) trained[fold.train.labelId(r)] = 1;
+
+                ConfusionMatrix confusion(n_labels);
+                for (size_t c = 0; c < n_labels; ++c) confusion.setActive(c, trained[c] != 0);
+                for (size_t i = 0; i < fold.test.size(); ++i) {
+                    int32_t predicted = predictions[ki * n_queries + query_offsets[f] + i];
+                    int32_t actual = fold.test.labelId(i);
+                    confusion.add(trained[actual] ? actual : -1, predicted);
+                }
+                result.fold_f1.push_back(confusion.macroF1());
+                all_folds.merge(confusion);
+            }
+
+            for (double f1 : result.fold_f1) result.mean_f1 += f1;
+            result.mean_f1 /= result.fold_f1.size();
+            for (double f1 : result.fold_f1) {
+                result.std_f1 += (f1 - result.mean_f1) * (f1 - result.mean_f1);
+            }
+            result.std_f1 = std::sqrt(result.std_f1 / result.fold_f1.size());
+            result.accuracy = all_folds.accuracy();
+            results.push_back(result);
+        }
+    }
+    return results;
+}
+
+const CrossValidator::Result* CrossValidator::best(const std::vector<Result>& results) {
+    const Result* winner = nullptr;
+    for (const auto& result : results) {
+        if (!winner || result.mean_f1 > winner->mean_f1 ||
+            (result.mean_f1 == winner->mean_f1 && result.k < winner->k)) {
+            winner = &result;
+        }
+    }
+    return winner;
+}
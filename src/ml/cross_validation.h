@@ -0,0 +1,64 @@
+#ifndef CROSS_VALIDATION_H
+#define CROSS_VALIDATION_H
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "data_processor.h"
+#include "knn_classifier.h"
+#include "thread_pool.h"
+
+// Подбор k (и метрики) кросс-валидацией. Для каждого тестового запроса
+// соседи ищутся один раз - для наибольшего k; голоса всех меньших k
+// получаются из префиксов этого отсортированного списка. Запросы всех
+// блоков обрабатываются параллельно.
+class CrossValidator {
+public:
+    enum class Metric {
+        Euclidean,   // через KNNClassifier: SIMD-ядра и индексы
+        Manhattan,   // полный перебор
+        Chebyshev    // полный перебор
+    };
+
+    struct Result {
+        Metric metric;
+        size_t k;
+        double mean_f1;              // макро-F1, среднее по блокам
+        double std_f1;
+        double accuracy;             // по всем тестовым строкам всех блоков
+        std::vector<double> fold_f1;
+    };
+
+private:
+    size_t n_folds;
+    uint64_t seed;
+    bool stratified;
+    KNNClassifier::IndexType index_type;
+    size_t num_threads;
+    std::shared_ptr<ThreadPool> own_pool;
+
+    ThreadPool* pool();
+
+public:
+    CrossValidator();
+
+    void setFolds(size_t k_folds) { n_folds = k_folds; }
+    void setSeed(uint64_t s) { seed = s; }
+    void setStratified(bool enabled) { stratified = enabled; }
+    // Индекс моделей блоков для евклидовой метрики
+    void setIndexType(KNNClassifier::IndexType type) { index_type = type; }
+    // 0 - общий пул, 1 - последовательно, n - свой пул из n потоков
+    void setNumThreads(size_t n);
+
+    static const char* metricName(Metric metric);
+
+    // Результаты для всех пар (метрика, k) в порядке metrics x ks
+    std::vector<Result> run(const std::shared_ptr<const DataProcessor::FeatureTable>& table,
+                            const std::vector<size_t>& ks,
+                            const std::vector<Metric>& metrics = {Metric::Euclidean});
+
+    // Лучший результат по среднему F1 (при равенстве - меньший k)
+    static const Result* best(const std::vector<Result>& results);
+};
+
+#endif
@@ -0,0 +1,123 @@
+#include "csv_batch_reader.h"
+#include "csv_parse.h"
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+CSVBatchReader::CSVBatchReader(const std::string& filename, size_t batch_rows,
+                               size_t buffer_bytes)
+    : file(filename, std::ios::binary), buffer(std::max<size_t>(buffer_bytes, 64)),
+      pos(0), end(0), eof(false), batch_rows(std::max<size_t>(batch_rows, 1)), rows_read(0),
+      last_label(-1), scaler(nullptr) {
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return;
+    }
+
+    // Первая строка - заголовки; последний столбец - метка
+    std::string_view header;
+    if (!nextLine(header)) return;
+    size_t cell_start = 0;
+    while (true) {
+        size_t comma = header.find(',', cell_start);
+        if (comma == std::string_view::npos) break;
+        feature_names.emplace_back(header.substr(cell_start, comma - cell_start));
+        cell_start = comma + 1;
+    }
+}
+
+bool CSVBatchReader::refill() {
+    if (eof) return false;
+
+    // Недоразобранный хвост переносится в начало буфера
+    size_t tail = end - pos;
+    std::memmove(buffer.data(), buffer.data() + pos, tail);
+    pos = 0;
+    end = tail;
+    if (end == buffer.size()) {
+        buffer.resize(buffer.size() * 2);  // строка длиннее буфера
+    }
+
+    file.read(buffer.data() + end, buffer.size() - end);
+    size_t got = static_cast<size_t>(file.gcount());
+    end += got;
+    if (got == 0 || !file) eof = true;
+    return got > 0;
+}
+
+bool CSVBatchReader::nextLine(std::string_view& line) {
+    while (true) {
+        const char* begin = buffer.data() + pos;
+        const char* newline = static_cast<const char*>(std::memchr(begin, '\n', end - pos));
+        if (newline) {
+            pos = newline + 1 - buffer.data();
+            line = csv::trimLine(begin, newline);
+        } else if (refill()) {
+            continue;
+        } else if (pos < end) {
+            // Последняя строка без перевода строки
+            line = csv::trimLine(begin, buffer.data() + end);
+            pos = end;
+        } else {
+            return false;
+        }
+        if (!line.empty()) return true;
+    }
+}
+
+int32_t CSVBatchReader::labelId(std::string_view label) {
+    // Метки обычно идут сериями, поэтому сначала сравнение с предыдущей
+    if (last_label >= 0 && label_names[last_label] == label) return last_label;
+
+    label_key.assign(label.data(), label.size());
+    auto found = label_ids.find(label_key);
+    if (found != label_ids.end()) return last_label = found->second;
+    int32_t id = static_cast<int32_t>(label_names.size());
+    label_names.push_back(label_key);
+    label_ids.emplace(label_key, id);
+    return last_label = id;
+}
+
+void CSVBatchReader::setLabelNames(const std::vector<std::string>& names) {
+    label_names.clear();
+    label_ids.clear();
+    last_label = -1;
+    for (const auto& name : names) {
+        labelId(name);
+    }
+}
+
+bool CSVBatchReader::next(DataProcessor::FeatureTable& batch) {
+    const size_t n_cols = feature_names.size();
+    if (batch.features.rows() != batch_rows || batch.features.cols() != n_cols) {
+        batch.features = FeatureMatrix(batch_rows, n_cols);
+    }
+    if (batch.feature_names.empty()) {
+        batch.feature_names = feature_names;
+    }
+    batch.label_ids.resize(batch_rows);
+
+    size_t count = 0;
+    std::string_view line;
+    while (count < batch_rows && nextLine(line)) {
+        double* dst = batch.features.row(count);
+        std::fill_n(dst, batch.features.stride(), 0.0);
+        batch.label_ids[count] = labelId(csv::parseRow(line, dst, n_cols));
+        if (scaler) scaler->transformRow(dst, n_cols);
+        ++count;
+    }
+    if (count == 0) return false;
+
+    // Последний неполный пакет: матрица ровно по числу строк
+    if (count < batch_rows) {
+        FeatureMatrix tail(count, n_cols);
+        std::copy_n(batch.features.data(), count * tail.stride(), tail.data());
+        batch.features = std::move(tail);
+        batch.label_ids.resize(count);
+    }
+    if (batch.label_names.size() != label_names.size()) {
+        batch.label_names = label_names;
+    }
+    rows_read += count;
+    return true;
+}
@@ -0,0 +1,65 @@
+#ifndef CSV_BATCH_READER_H
+#define CSV_BATCH_READER_H
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <unordered_map>
+#include <cstdint>
+#include "data_processor.h"
+#include "feature_scaler.h"
+
+// Потоковое чтение CSV пакетами фиксированного числа строк.
+// В памяти одновременно находятся только буфер чтения и один пакет,
+// поэтому можно обрабатывать файлы больше объема RAM.
+class CSVBatchReader {
+private:
+    std::ifstream file;
+    std::vector<char> buffer;   // непрочитанная часть файла: [pos, end)
+    size_t pos;
+    size_t end;
+    bool eof;
+    size_t batch_rows;
+    size_t rows_read;
+    std::vector<std::string> feature_names;
+    std::vector<std::string> label_names;
+    std::unordered_map<std::string, int32_t> label_ids;
+    // Поиск метки без выделения памяти на строку: метка предыдущей строки
+    // и переиспользуемый буфер ключа (C++17 не ищет по string_view)
+    int32_t last_label;
+    std::string label_key;
+    const FeatureScaler* scaler;
+
+    // Дочитывание файла в буфер; false, если данных больше нет
+    bool refill();
+    // Следующая непустая строка; false в конце файла
+    bool nextLine(std::string_view& line);
+    int32_t labelId(std::string_view label);
+
+public:
+    // batch_rows - строк в пакете, buffer_bytes - размер буфера чтения
+    // (увеличивается, только если одна строка длиннее буфера)
+    explicit CSVBatchReader(const std::string& filename, size_t batch_rows = 4096,
+                            size_t buffer_bytes = 1 << 20);
+
+    bool isOpen() const { return file.is_open(); }
+
+    // Заранее заданный словарь меток, например классы обученной модели:
+    // номера меток в пакетах совпадут с номерами классов
+    void setLabelNames(const std::vector<std::string>& names);
+
+    // Обученный scaler применяется к строкам сразу при разборе
+    // (объект должен жить, пока идет чтение; nullptr - без масштабирования)
+    void setScaler(const FeatureScaler* s) { scaler = s; }
+
+    // Следующий пакет: матрица признаков, номера меток и текущий словарь.
+    // Буферы batch переиспользуются между вызовами. false в конце файла.
+    bool next(DataProcessor::FeatureTable& batch);
+
+    size_t batchRows() const { return batch_rows; }
+    size_t rowsRead() const { return rows_read; }
+    const std::vector<std::string>& featureNames() const { return feature_names; }
+    const std::vector<std::string>& labelNames() const { return label_names; }
+};
+
+#endif
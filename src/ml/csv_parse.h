@@ -0,0 +1,63 @@
+#ifndef CSV_PARSE_H
+#define CSV_PARSE_H
+
+#include <string_view>
+#include <charconv>
+#include <cstring>
+#include <cstddef>
+
+// Разбор CSV без промежуточных строк: общие функции загрузчика целого
+// файла (DataProcessor::loadCSVTable) и потокового чтения (CSVBatchReader).
+// Формат: признаки через запятую, последний столбец - метка.
+namespace csv {
+
+// Строка без завершающего '\r' (файлы с окончаниями CRLF)
+inline std::string_view trimLine(const char* begin, const char* end) {
+    if (end > begin && end[-1] == '\r') --end;
+    return std::string_view(begin, end - begin);
+}
+
+// Вызов fn для каждой непустой строки в [begin, end)
+template <typename Fn>
+void forEachLine(const char* begin, const char* end, Fn&& fn) {
+    while (begin < end) {
+        const char* newline = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+        const char* line_end = newline ? newline : end;
+        std::string_view line = trimLine(begin, line_end);
+        if (!line.empty()) fn(line);
+        begin = newline ? newline + 1 : end;
+    }
+}
+
+// Число из ячейки по правилам std::stod: ведущие пробелы и '+' допускаются,
+// хвост после числа игнорируется, нечисловая ячейка дает 0
+inline double parseCell(const char* begin, const char* end) {
+    while (begin < end && (*begin == ' ' || *begin == '\t')) ++begin;
+    if (begin < end && *begin == '+') ++begin;
+    double value = 0.0;
+    if (std::from_chars(begin, end, value).ec != std::errc()) {
+        return 0.0;
+    }
+    return value;
+}
+
+// Разбор строки данных: первые n_cols ячеек - в dst (недостающие не
+// трогаются, dst должен быть заранее обнулен), возвращается метка
+inline std::string_view parseRow(std::string_view line, double* dst, size_t n_cols) {
+    const char* cursor = line.data();
+    const char* line_end = line.data() + line.size();
+    for (size_t j = 0; j < n_cols; ++j) {
+        const char* comma = static_cast<const char*>(std::memchr(cursor, ',', line_end - cursor));
+        if (!comma) break;
+        dst[j] = parseCell(cursor, comma);
+        cursor = comma + 1;
+    }
+
+    const char* label_begin = line_end;
+    while (label_begin > line.data() && label_begin[-1] != ',') --label_begin;
+    return std::string_view(label_begin, line_end - label_begin);
+}
+
+} // namespace csv
+
+#endif
@@ -1,116 +1,324 @@
 #include "data_processor.h"
-#include <fstream>
-#include <sstream>
+#include "mapped_file.h"
+#include "thread_pool.h"
+#include "csv_parse.h"
+#include "dataset_cache.h"
+#include "feature_scaler.h"
 #include <iostream>
 #include <algorithm>
 #include <random>
+#include <limits>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <unordered_map>
 
-DataProcessor::NetworkTrafficData DataProcessor::loadFromCSV(const std::string& filename) {
-    NetworkTrafficData result;
-    std::ifstream file(filename);
-    
-    if (!file.is_open()) {
+namespace {
+
+// Минимальный размер части файла для параллельного разбора
+const size_t CSV_MIN_CHUNK = 1 << 20;
+
+// Метки одной части файла: локальные номера в порядке первого появления
+struct ChunkLabels {
+    std::vector<std::string_view> names;
+    std::unordered_map<std::string_view, int32_t> ids;
+};
+
+// Минимумы и максимумы признаков одной части файла
+struct ChunkRanges {
+    std::vector<double> mins;
+    std::vector<double> maxs;
+};
+
+// Перемешивание Фишера-Йетса с собственным выбором позиции: в отличие от
+// std::shuffle результат для заданного зерна одинаков во всех реализациях
+// стандартной библиотеки
+template <typename Iterator>
+void shuffleRows(Iterator begin, Iterator end, std::mt19937_64& gen) {
+    for (auto n = end - begin; n > 1; --n) {
+        std::iter_swap(begin + (n - 1), begin + static_cast<std::ptrdiff_t>(gen() % n));
+    }
+}
+
+// Номера строк по меткам (stratified) или одной группой
+std::vector<std::vector<uint32_t>> rowGroups(const DataProcessor::FeatureTable& table,
+                                             bool stratified) {
+    std::vector<std::vector<uint32_t>> groups(stratified ? table.label_names.size() : 1);
+    for (size_t row = 0; row < table.label_ids.size(); ++row) {
+        groups[stratified ? table.label_ids[row] : 0].push_back(static_cast<uint32_t>(row));
+    }
+    return groups;
+}
+
+} // namespace
+
+DataProcessor::DataProcessor() : use_cache(true) {}
+
+DataProcessor::FeatureTable DataProcessor::loadCSVTable(const std::string& filename,
+                                                        size_t num_threads,
+                                                        const FeatureScaler* scaler) {
+    FeatureTable result;
+    std::shared_ptr<MappedFile> file = MappedFile::open(filename);
+    if (!file) {
         std::cerr << "Error: Could not open file " << filename << std::endl;
         return result;
     }
-    
-    std::string line;
-    bool is_first_line = true;
-    
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        std::string cell;
-        std::vector<std::string> row;
-        
-        while (std::getline(ss, cell, ',')) {
-            row.push_back(cell);
+    if (file->size() == 0) {
+        std::cerr << "Error: empty file " << filename << std::endl;
+        return result;
+    }
+    file->adviseSequential();
+
+    const char* data = reinterpret_cast<const char*>(file->data());
+    const char* data_end = data + file->size();
+
+    // Первая строка - заголовки; последний столбец - метка
+    const char* header_end = static_cast<const char*>(std::memchr(data, '\n', file->size()));
+    if (!header_end) header_end = data_end;
+    std::string_view header = csv::trimLine(data, header_end);
+    size_t cell_start = 0;
+    while (true) {
+        size_t comma = header.find(',', cell_start);
+        if (comma == std::string_view::npos) break;
+        result.feature_names.emplace_back(header.substr(cell_start, comma - cell_start));
+        cell_start = comma + 1;
+    }
+    const size_t n_cols = result.feature_names.size();
+    const char* body = header_end < data_end ? header_end + 1 : data_end;
+
+    std::unique_ptr<ThreadPool> own_pool;
+    ThreadPool* pool = nullptr;
+    if (num_threads == 0) {
+        pool = &ThreadPool::shared();
+    } else if (num_threads > 1) {
+        own_pool.reset(new ThreadPool(num_threads));
+        pool = own_pool.get();
+    }
+    size_t workers = pool ? pool->size() + 1 : 1;
+
+    // Части файла по границам строк
+    size_t body_size = data_end - body;
+    size_t target = std::max(CSV_MIN_CHUNK, body_size / (workers * 4) + 1);
+    std::vector<const char*> bounds = {body};
+    while (bounds.back() < data_end) {
+        const char* next = bounds.back() + std::min(target, static_cast<size_t>(data_end - bounds.back()));
+        if (next < data_end) {
+            const char* newline = static_cast<const char*>(std::memchr(next, '\n', data_end - next));
+            next = newline ? newline + 1 : data_end;
         }
-        
-        if (is_first_line) {
-            // Первая строка - заголовки
-            for (size_t i = 0; i < row.size() - 1; ++i) {
-                result.feature_names.push_back(row[i]);
-            }
-            is_first_line = false;
+        bounds.push_back(next);
+    }
+    const size_t n_chunks = bounds.size() - 1;
+
+    auto run = [pool](size_t n, const std::function<void(size_t, size_t)>& body_fn) {
+        if (pool) {
+            pool->parallelFor(0, n, 1, body_fn);
         } else {
-            // Данные
-            std::vector<double> features;
-            
-            // Преобразование всех столбцов, кроме последнего, в числа
-            for (size_t i = 0; i < row.size() - 1; ++i) {
-                try {
-                    double value = std::stod(row[i]);
-                    features.push_back(value);
-                } catch (...) {
-                    features.push_back(0.0);
+            body_fn(0, n);
+        }
+    };
+
+    // Проход 1: число строк в каждой части
+    std::vector<size_t> row_offsets(n_chunks + 1, 0);
+    run(n_chunks, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) {
+            size_t rows = 0;
+            csv::forEachLine(bounds[c], bounds[c + 1], [&rows](std::string_view) { ++rows; });
+            row_offsets[c + 1] = rows;
+        }
+    });
+    for (size_t c = 0; c < n_chunks; ++c) {
+        row_offsets[c + 1] += row_offsets[c];
+    }
+
+    // Проход 2: разбор прямо в строки матрицы
+    const size_t n_rows = row_offsets[n_chunks];
+    result.features = FeatureMatrix(n_rows, n_cols);
+    result.label_ids.resize(n_rows);
+    std::vector<ChunkLabels> chunk_labels(n_chunks);
+    std::vector<ChunkRanges> chunk_ranges(n_chunks);
+
+    run(n_chunks, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) {
+            size_t row = row_offsets[c];
+            ChunkLabels& labels = chunk_labels[c];
+            // Диапазоны признаков считаются попутно, пока строка в кэше
+            std::vector<double>& mins = chunk_ranges[c].mins;
+            std::vector<double>& maxs = chunk_ranges[c].maxs;
+            mins.assign(n_cols, std::numeric_limits<double>::max());
+            maxs.assign(n_cols, std::numeric_limits<double>::lowest());
+            csv::forEachLine(bounds[c], bounds[c + 1], [&](std::string_view line) {
+                double* dst = result.features.row(row);
+                std::string_view label = csv::parseRow(line, dst, n_cols);
+                if (scaler) scaler->transformRow(dst, n_cols);
+                for (size_t j = 0; j < n_cols; ++j) {
+                    if (dst[j] < mins[j]) mins[j] = dst[j];
+                    if (dst[j] > maxs[j]) maxs[j] = dst[j];
+                }
+                auto found = labels.ids.find(label);
+                if (found == labels.ids.end()) {
+                    found = labels.ids.emplace(label, static_cast<int32_t>(labels.names.size())).first;
+                    labels.names.push_back(label);
                 }
+                result.label_ids[row] = found->second;
+                ++row;
+            });
+        }
+    });
+
+    // Общий словарь меток: части обходятся по порядку, поэтому номера
+    // совпадают с порядком первого появления в файле
+    std::unordered_map<std::string_view, int32_t> global_ids;
+    std::vector<std::vector<int32_t>> remap(n_chunks);
+    for (size_t c = 0; c < n_chunks; ++c) {
+        for (const auto& name : chunk_labels[c].names) {
+            auto found = global_ids.find(name);
+            if (found == global_ids.end()) {
+                found = global_ids.emplace(name, static_cast<int32_t>(result.label_names.size())).first;
+                result.label_names.emplace_back(name);
+            }
+            remap[c].push_back(found->second);
+        }
+    }
+    run(n_chunks, [&](size_t begin, size_t end) {
+        for (size_t c = begin; c < end; ++c) {
+            for (size_t row = row_offsets[c]; row < row_offsets[c + 1]; ++row) {
+                result.label_ids[row] = remap[c][result.label_ids[row]];
             }
-            
-            result.features.push_back(features);
-            
-            // Последний столбец - метка
-            std::string label = row.back();
-            result.labels.push_back(label);
-            
-            // Обновление кодирования меток
-            if (result.label_encoding.find(label) == result.label_encoding.end()) {
-                int code = result.label_encoding.size();
-                result.label_encoding[label] = code;
+        }
+    });
+
+    if (n_rows > 0) {
+        result.ranges.mins.assign(n_cols, std::numeric_limits<double>::max());
+        result.ranges.maxs.assign(n_cols, std::numeric_limits<double>::lowest());
+        for (const auto& ranges : chunk_ranges) {
+            for (size_t j = 0; j < ranges.mins.size(); ++j) {
+                result.ranges.mins[j] = std::min(result.ranges.mins[j], ranges.mins[j]);
+                result.ranges.maxs[j] = std::max(result.ranges.maxs[j], ranges.maxs[j]);
             }
         }
     }
+
+    std::cout << "Loaded " << n_rows << " samples with "
+              << n_cols << " features" << std::endl;
+    return result;
+}
+
+DataProcessor::FeatureTable DataProcessor::loadDataset(const std::string& filename,
+                                                       size_t num_threads) {
+    if (!use_cache) {
+        return loadCSVTable(filename, num_threads);
+    }
+
+    const std::string cache_path = filename + ".cols";
+    uint64_t source_size = 0;
+    int64_t source_mtime = 0;
+    bool have_source = ColumnarDataset::sourceStamp(filename, source_size, source_mtime);
+
+    std::shared_ptr<ColumnarDataset> cached = ColumnarDataset::open(cache_path);
+    if (cached && (!have_source || (cached->sourceSize() == source_size &&
+                                    cached->sourceMtime() == source_mtime))) {
+        FeatureTable table = cached->toTable(num_threads);
+        std::cout << "Loaded " << table.features.rows() << " samples with "
+                  << table.features.cols() << " features from cache" << std::endl;
+        return table;
+    }
+
+    FeatureTable table = loadCSVTable(filename, num_threads);
+    if (have_source && !table.features.empty() &&
+        !ColumnarDataset::write(cache_path, table, source_size, source_mtime)) {
+        std::cerr << "Warning: could not write dataset cache " << cache_path << std::endl;
+    }
+    return table;
+}
+
+DataProcessor::NetworkTrafficData DataProcessor::loadFromCSV(const std::string& filename) {
+    NetworkTrafficData result;
+    FeatureTable table = loadDataset(filename);
     
-    file.close();
-    std::cout << "Loaded " << result.features.size() << " samples with " 
-              << result.feature_names.size() << " features" << std::endl;
+    result.feature_names = table.feature_names;
+    result.ranges = table.ranges;
+    for (size_t c = 0; c < table.label_names.size(); ++c) {
+        result.label_encoding[table.label_names[c]] = static_cast<int>(c);
+    }
+    
+    size_t n_cols = table.features.cols();
+    result.label_ids = table.label_ids;
+    result.features.reserve(table.features.rows());
+    result.labels.reserve(table.features.rows());
+    for (size_t i = 0; i < table.features.rows(); ++i) {
+        const double* row = table.features.row(i);
+        result.features.emplace_back(row, row + n_cols);
+        result.labels.push_back(table.label_names[table.label_ids[i]]);
+    }
     
     return result;
 }
 
 void DataProcessor::normalizeFeatures(std::vector<std::vector<double>>& features) {
+    NormalizationParams params;
+    normalizeFeatures(features, params);
+}
+
+void DataProcessor::normalizeFeatures(std::vector<std::vector<double>>& features,
+                                      NormalizationParams& params) {
     if (features.empty()) return;
     
-    size_t n_features = features[0].size();
-    std::vector<double> mins(n_features, std::numeric_limits<double>::max());
-    std::vector<double> maxs(n_features, std::numeric_limits<double>::lowest());
+    FeatureScaler scaler(FeatureScaler::Method::MinMax);
+    scaler.fit(features);
+    params = scaler.ranges();
+    scaler.transform(features);
+}
+
+void DataProcessor::normalizeFeatures(NetworkTrafficData& data, NormalizationParams& params) {
+    if (data.features.empty()) return;
     
-    // Нахождение минимумов и максимумов
-    for (const auto& sample : features) {
-        for (size_t i = 0; i < n_features; ++i) {
-            if (sample[i] < mins[i]) mins[i] = sample[i];
-            if (sample[i] > maxs[i]) maxs[i] = sample[i];
-        }
+    size_t n_features = data.features[0].size();
+    if (data.ranges.mins.size() != n_features || data.ranges.maxs.size() != n_features) {
+        normalizeFeatures(data.features, params);
+        return;
     }
     
-    // Нормализация
-    for (auto& sample : features) {
-        for (size_t i = 0; i < n_features; ++i) {
-            double range = maxs[i] - mins[i];
-            if (range > 0) {
-                sample[i] = (sample[i] - mins[i]) / range;
-            } else {
-                sample[i] = 0.0;
-            }
-        }
+    params = data.ranges;
+    applyNormalization(data.features, params);
+    // После нормализации диапазон каждого признака - [0, 1]
+    for (size_t i = 0; i < n_features; ++i) {
+        bool constant = !(params.maxs[i] > params.mins[i]);
+        data.ranges.mins[i] = 0.0;
+        data.ranges.maxs[i] = constant ? 0.0 : 1.0;
     }
 }
 
+void DataProcessor::applyNormalization(std::vector<std::vector<double>>& features,
+                                       const NormalizationParams& params) {
+    FeatureScaler scaler;
+    scaler.fitRanges(params);
+    scaler.transform(features);
+}
+
 void DataProcessor::splitData(const NetworkTrafficData& data,
                              double train_ratio,
                              NetworkTrafficData& train_data,
                              NetworkTrafficData& test_data) {
+    std::random_device rd;
+    splitData(data, train_ratio, train_data, test_data,
+              (static_cast<uint64_t>(rd()) << 32) | rd());
+}
+
+void DataProcessor::splitData(const NetworkTrafficData& data,
+                             double train_ratio,
+                             NetworkTrafficData& train_data,
+                             NetworkTrafficData& test_data,
+                             uint64_t seed) {
     if (data.features.empty()) return;
     
-    // Создание индексов для перемешивания
-    std::vector<size_t> indices(data.features.size());
+    // Создание и перемешивание индексов
+    std::vector<uint32_t> indices(data.features.size());
     for (size_t i = 0; i < indices.size(); ++i) {
-        indices[i] = i;
+        indices[i] = static_cast<uint32_t>(i);
     }
-    
-    // Перемешивание индексов
-    std::random_device rd;
-    std::mt19937 g(rd());
-    std::shuffle(indices.begin(), indices.end(), g);
+    std::mt19937_64 gen(seed);
+    shuffleRows(indices.begin(), indices.end(), gen);
     
     // Разделение данных
     size_t train_size = static_cast<size_t>(data.features.size() * train_ratio);
@@ -120,18 +328,72 @@ void DataProcessor::splitData(const NetworkTrafficData& data,
     train_data.label_encoding = data.label_encoding;
     test_data.label_encoding = data.label_encoding;
     
+    bool have_ids = data.label_ids.size() == data.features.size();
     for (size_t i = 0; i < indices.size(); ++i) {
         size_t idx = indices[i];
-        
-        if (i < train_size) {
-            train_data.features.push_back(data.features[idx]);
-            train_data.labels.push_back(data.labels[idx]);
-        } else {
-            test_data.features.push_back(data.features[idx]);
-            test_data.labels.push_back(data.labels[idx]);
+        NetworkTrafficData& target = i < train_size ? train_data : test_data;
+        target.features.push_back(data.features[idx]);
+        target.labels.push_back(data.labels[idx]);
+        if (have_ids) {
+            target.label_ids.push_back(data.label_ids[idx]);
         }
     }
     
     std::cout << "Split data: " << train_data.features.size() << " training, "
               << test_data.features.size() << " test samples" << std::endl;
-}
\ No newline at end of file
+}
+
+void DataProcessor::splitTable(const std::shared_ptr<const FeatureTable>& table,
+                               double train_ratio, uint64_t seed, bool stratified,
+                               DatasetView& train, DatasetView& test) {
+    train.table = table;
+    test.table = table;
+    train.rows.clear();
+    test.rows.clear();
+    if (!table) return;
+    
+    // Каждая группа (метка или вся таблица) перемешивается, первые
+    // train_ratio ее строк уходят в train
+    std::mt19937_64 gen(seed);
+    for (auto& group : rowGroups(*table, stratified)) {
+        shuffleRows(group.begin(), group.end(), gen);
+        size_t train_size = static_cast<size_t>(std::llround(group.size() * train_ratio));
+        train.rows.insert(train.rows.end(), group.begin(), group.begin() + train_size);
+        test.rows.insert(test.rows.end(), group.begin() + train_size, group.end());
+    }
+    
+    // Номера по возрастанию: обход представления идет по памяти подряд
+    std::sort(train.rows.begin(), train.rows.end());
+    std::sort(test.rows.begin(), test.rows.end());
+}
+
+std::vector<DataProcessor::Fold> DataProcessor::kFoldViews(
+    const std::shared_ptr<const FeatureTable>& table, size_t k, uint64_t seed, bool stratified) {
+    std::vector<Fold> folds;
+    if (!table || k < 2) return folds;
+    
+    // Строки каждой группы раздаются по частям по кругу; сдвиг между
+    // группами выравнивает размеры частей
+    const size_t n_rows = table->label_ids.size();
+    std::vector<uint32_t> fold_of(n_rows);
+    std::mt19937_64 gen(seed);
+    size_t next = 0;
+    for (auto& group : rowGroups(*table, stratified)) {
+        shuffleRows(group.begin(), group.end(), gen);
+        for (uint32_t row : group) {
+            fold_of[row] = static_cast<uint32_t>(next++ % k);
+        }
+    }
+    
+    folds.resize(k);
+    for (auto& fold : folds) {
+        fold.train.table = table;
+        fold.test.table = table;
+    }
+    for (size_t row = 0; row < n_rows; ++row) {
+        for (size_t f = 0; f < k; ++f) {
+            (f == fold_of[row] ? folds[f].test : folds[f].train).rows.push_back(static_cast<uint32_t>(row));
+        }
+    }
+    return folds;
+}
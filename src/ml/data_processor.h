@@ -4,22 +4,107 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <cstdint>
+#include <memory>
+#include "feature_matrix.h"
+
+class FeatureScaler;
 
 class DataProcessor {
+private:
+    bool use_cache;
+
 public:
+    // Параметры min-max нормализации, вычисленные на обучающей выборке
+    struct NormalizationParams {
+        std::vector<double> mins;
+        std::vector<double> maxs;
+    };
+    
     struct NetworkTrafficData {
         std::vector<std::vector<double>> features;
         std::vector<std::string> labels;
         std::vector<std::string> feature_names;
         std::map<std::string, int> label_encoding;
+        // Номера меток по label_encoding, по одному на строку
+        std::vector<int32_t> label_ids;
+        // Минимум и максимум каждого признака, если известны при загрузке
+        NormalizationParams ranges;
+    };
+    
+    // Данные в непрерывном виде: выровненная матрица признаков и номера
+    // меток (индексы в label_names в порядке первого появления)
+    struct FeatureTable {
+        FeatureMatrix features;
+        std::vector<int32_t> label_ids;
+        std::vector<std::string> label_names;
+        std::vector<std::string> feature_names;
+        NormalizationParams ranges;
+    };
+    
+    // Подмножество строк таблицы без копирования данных: номера строк
+    // (по возрастанию) и общий указатель на исходную таблицу
+    struct DatasetView {
+        std::shared_ptr<const FeatureTable> table;
+        std::vector<uint32_t> rows;
+        
+        size_t size() const { return rows.size(); }
+        const double* features(size_t i) const { return table->features.row(rows[i]); }
+        int32_t labelId(size_t i) const { return table->label_ids[rows[i]]; }
+        const std::string& label(size_t i) const { return table->label_names[labelId(i)]; }
     };
     
+    // Блок кросс-валидации: test - одна часть, train - остальные
+    struct Fold {
+        DatasetView train;
+        DatasetView test;
+    };
+    
+    DataProcessor();
+    
+    // Столбцовый кэш (<файл>.cols, см. dataset_cache.h): при первой загрузке
+    // CSV он записывается рядом, при следующих открывается вместо разбора
+    // текста. Кэш устаревает при изменении размера или времени CSV.
+    void setDatasetCache(bool enabled) { use_cache = enabled; }
+    
     NetworkTrafficData loadFromCSV(const std::string& filename);
+    // Загрузка через столбцовый кэш (если включен), иначе loadCSVTable
+    FeatureTable loadDataset(const std::string& filename, size_t num_threads = 0);
+    // Быстрая загрузка CSV: файл отображается в память, числа разбираются
+    // std::from_chars прямо в матрицу, части файла - параллельно.
+    // num_threads: 0 - общий пул, 1 - последовательно, n - свой пул.
+    // Обученный scaler применяется к каждой строке сразу после разбора.
+    FeatureTable loadCSVTable(const std::string& filename, size_t num_threads = 0,
+                              const FeatureScaler* scaler = nullptr);
     void normalizeFeatures(std::vector<std::vector<double>>& features);
+    // То же с сохранением параметров для тестовых и новых данных
+    void normalizeFeatures(std::vector<std::vector<double>>& features,
+                           NormalizationParams& params);
+    // Нормализация загруженных данных: известные диапазоны признаков
+    // используются без отдельного прохода поиска минимумов и максимумов
+    void normalizeFeatures(NetworkTrafficData& data, NormalizationParams& params);
+    void applyNormalization(std::vector<std::vector<double>>& features,
+                            const NormalizationParams& params);
     void splitData(const NetworkTrafficData& data,
                    double train_ratio,
                    NetworkTrafficData& train_data,
                    NetworkTrafficData& test_data);
+    // То же с заданным зерном: разбиение воспроизводимо
+    void splitData(const NetworkTrafficData& data,
+                   double train_ratio,
+                   NetworkTrafficData& train_data,
+                   NetworkTrafficData& test_data,
+                   uint64_t seed);
+    
+    // Разбиения-представления: строки не копируются, память растет только
+    // на номера строк. При stratified доля каждой метки в train и test
+    // совпадает с долей во всей таблице. Одинаковое зерно - одинаковое
+    // разбиение на любой платформе.
+    void splitTable(const std::shared_ptr<const FeatureTable>& table,
+                    double train_ratio, uint64_t seed, bool stratified,
+                    DatasetView& train, DatasetView& test);
+    std::vector<Fold> kFoldViews(const std::shared_ptr<const FeatureTable>& table,
+                                 size_t k, uint64_t seed, bool stratified = true);
 };
 
 #endif
\ No newline at end of file
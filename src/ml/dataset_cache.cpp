@@ -0,0 +1,353 @@
+#include "dataset_cache.h"
+#include "thread_pool.h"
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <functional>
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+
+// Формат файла (версия 1, родной порядок байт):
+//
+//   FileHeader
+//   ColumnEntry[n_cols]            тип, положение и диапазон каждого столбца
+//   имена признаков                uint32 длина + байты
+//   словарь меток                  uint32 длина + байты
+//   номера меток                   int32 на строку
+//   столбцы признаков              каждый с границы 64 байт
+
+namespace {
+
+const char DATASET_MAGIC[8] = {'K', 'N', 'N', 'C', 'O', 'L', 'S', '\0'};
+const uint32_t DATASET_VERSION = 1;
+const uint64_t ENDIAN_TAG = 0x0102030405060708ULL;
+const size_t SECTION_ALIGNMENT = 64;
+const size_t DECODE_BLOCK = 4096;
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t n_cols;
+    uint64_t n_rows;
+    uint64_t endian_tag;
+    uint64_t source_size;
+    int64_t source_mtime;
+    uint32_t n_labels;
+    uint32_t reserved;
+    uint64_t names_offset;
+    uint64_t names_bytes;
+    uint64_t dict_offset;
+    uint64_t dict_bytes;
+    uint64_t labels_offset;
+    uint64_t file_size;
+};
+
+struct ColumnEntry {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t bytes;
+    double min;
+    double max;
+};
+
+size_t alignUp(size_t value) {
+    return (value + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+size_t typeSize(ColumnarDataset::ColumnType type) {
+    switch (type) {
+        case ColumnarDataset::ColumnType::UInt8: return sizeof(uint8_t);
+        case ColumnarDataset::ColumnType::Int32: return sizeof(int32_t);
+        case ColumnarDataset::ColumnType::Float32: return sizeof(float);
+        case ColumnarDataset::ColumnType::Float64: return sizeof(double);
+    }
+    return 0;
+}
+
+// Строки с префиксом длины
+std::vector<char> packStrings(const std::vector<std::string>& strings) {
+    std::vector<char> packed;
+    for (const auto& value : strings) {
+        uint32_t length = static_cast<uint32_t>(value.size());
+        const char* raw = reinterpret_cast<const char*>(&length);
+        packed.insert(packed.end(), raw, raw + sizeof(length));
+        packed.insert(packed.end(), value.begin(), value.end());
+    }
+    return packed;
+}
+
+bool unpackStrings(const uint8_t* data, size_t bytes, size_t count, std::vector<std::string>& out) {
+    const uint8_t* end = data + bytes;
+    for (size_t i = 0; i < count; ++i) {
+        uint32_t length;
+        if (static_cast<size_t>(end - data) < sizeof(length)) return false;
+        std::memcpy(&length, data, sizeof(length));
+        data += sizeof(length);
+        if (static_cast<size_t>(end - data) < length) return false;
+        out.emplace_back(reinterpret_cast<const char*>(data), length);
+        data += length;
+    }
+    return true;
+}
+
+template <typename T>
+void decodeAs(const void* column, size_t begin, size_t end, double* out, size_t stride) {
+    const T* values = static_cast<const T*>(column);
+    for (size_t i = begin; i < end; ++i, out += stride) {
+        *out = static_cast<double>(values[i]);
+    }
+}
+
+template <typename T>
+void encodeAs(const FeatureMatrix& matrix, size_t j, std::vector<char>& out) {
+    out.resize(matrix.rows() * sizeof(T));
+    T* values = reinterpret_cast<T*>(out.data());
+    for (size_t i = 0; i < matrix.rows(); ++i) {
+        values[i] = static_cast<T>(matrix.at(i, j));
+    }
+}
+
+} // namespace
+
+ColumnarDataset::ColumnarDataset()
+    : label_codes(nullptr), n_rows(0), source_size(0), source_mtime(0) {}
+
+bool ColumnarDataset::sourceStamp(const std::string& path, uint64_t& size, int64_t& mtime) {
+    std::error_code error;
+    auto file_size = std::filesystem::file_size(path, error);
+    if (error) return false;
+    auto time = std::filesystem::last_write_time(path, error);
+    if (error) return false;
+    size = static_cast<uint64_t>(file_size);
+    mtime = static_cast<int64_t>(time.time_since_epoch().count());
+    return true;
+}
+
+bool ColumnarDataset::write(const std::string& path, const DataProcessor::FeatureTable& table,
+                            uint64_t source_size, int64_t source_mtime) {
+    const FeatureMatrix& matrix = table.features;
+    const size_t n_rows = matrix.rows();
+    const size_t n_cols = matrix.cols();
+
+    // Один построчный проход: диапазоны и самый узкий точный тип столбцов
+    std::vector<double> mins(n_cols, std::numeric_limits<double>::max());
+    std::vector<double> maxs(n_cols, std::numeric_limits<double>::lowest());
+    std::vector<char> is_integer(n_cols, 1);
+    std::vector<char> fits_float(n_cols, 1);
+    for (size_t i = 0; i < n_rows; ++i) {
+        const double* row = matrix.row(i);
+        for (size_t j = 0; j < n_cols; ++j) {
+            double value = row[j];
+            if (value < mins[j]) mins[j] = value;
+            if (value > maxs[j]) maxs[j] = value;
+            if (is_integer[j] && !(std::floor(value) == value)) is_integer[j] = 0;
+            if (fits_float[j] && !(static_cast<double>(static_cast<float>(value)) == value)) {
+                fits_float[j] = 0;
+            }
+        }
+    }
+
+    std::vector<ColumnEntry> entries(n_cols);
+    for (size_t j = 0; j < n_cols; ++j) {
+        ColumnType type = ColumnType::Float64;
+        if (n_rows > 0 && is_integer[j] && mins[j] >= 0 && maxs[j] <= 255) {
+            type = ColumnType::UInt8;
+        } else if (n_rows > 0 && is_integer[j] && mins[j] >= std::numeric_limits<int32_t>::min() &&
+                   maxs[j] <= std::numeric_limits<int32_t>::max()) {
+            type = ColumnType::Int32;
+        } else if (fits_float[j]) {
+            type = ColumnType::Float32;
+        }
+        entries[j] = {static_cast<uint32_t>(type), 0, 0, n_rows * typeSize(type),
+                      n_rows > 0 ? mins[j] : 0.0, n_rows > 0 ? maxs[j] : 0.0};
+    }
+
+    std::vector<std::string> names(table.feature_names);
+    names.resize(n_cols);
+    std::vector<char> packed_names = packStrings(names);
+    std::vector<char> packed_labels = packStrings(table.label_names);
+
+    // Размещение секций
+    FileHeader header = {};
+    std::memcpy(header.magic, DATASET_MAGIC, sizeof(DATASET_MAGIC));
+    header.version = DATASET_VERSION;
+    header.n_cols = static_cast<uint32_t>(n_cols);
+    header.n_rows = n_rows;
+    header.endian_tag = ENDIAN_TAG;
+    header.source_size = source_size;
+    header.source_mtime = source_mtime;
+    header.n_labels = static_cast<uint32_t>(table.label_names.size());
+    header.names_offset = sizeof(FileHeader) + n_cols * sizeof(ColumnEntry);
+    header.names_bytes = packed_names.size();
+    header.dict_offset = header.names_offset + header.names_bytes;
+    header.dict_bytes = packed_labels.size();
+    header.labels_offset = alignUp(header.dict_offset + header.dict_bytes);
+    size_t offset = alignUp(header.labels_offset + n_rows * sizeof(int32_t));
+    for (auto& entry : entries) {
+        entry.offset = offset;
+        offset = alignUp(offset + entry.bytes);
+    }
+    header.file_size = offset;
+
+    // Кэш пишется во временный файл и заменяет старый переименованием:
+    // другие процессы могут держать старый кэш отображенным в память
+    const std::string temp_path = path + ".tmp";
+    std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) return false;
+
+    const char zeros[SECTION_ALIGNMENT] = {};
+    size_t written = 0;
+    auto put = [&](size_t at, const void* data, size_t bytes) {
+        file.write(zeros, at - written);
+        file.write(static_cast<const char*>(data), bytes);
+        written = at + bytes;
+    };
+
+    put(0, &header, sizeof(header));
+    put(written, entries.data(), entries.size() * sizeof(ColumnEntry));
+    put(header.names_offset, packed_names.data(), packed_names.size());
+    put(header.dict_offset, packed_labels.data(), packed_labels.size());
+    put(header.labels_offset, table.label_ids.data(), n_rows * sizeof(int32_t));
+
+    // Столбцы кодируются по одному: в памяти не больше одного столбца
+    std::vector<char> encoded;
+    for (size_t j = 0; j < n_cols; ++j) {
+        switch (static_cast<ColumnType>(entries[j].type)) {
+            case ColumnType::UInt8: encodeAs<uint8_t>(matrix, j, encoded); break;
+            case ColumnType::Int32: encodeAs<int32_t>(matrix, j, encoded); break;
+            case ColumnType::Float32: encodeAs<float>(matrix, j, encoded); break;
+            case ColumnType::Float64: encodeAs<double>(matrix, j, encoded); break;
+        }
+        put(entries[j].offset, encoded.data(), encoded.size());
+    }
+    file.write(zeros, header.file_size - written);
+    file.flush();
+
+    if (!file) {
+        std::remove(temp_path.c_str());
+        return false;
+    }
+    file.close();
+    return MappedFile::replace(temp_path, path);
+}
+
+std::shared_ptr<ColumnarDataset> ColumnarDataset::open(const std::string& path) {
+    std::shared_ptr<MappedFile> file = MappedFile::open(path);
+    if (!file || file->size() < sizeof(FileHeader)) return nullptr;
+
+    const uint8_t* base = file->data();
+    FileHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, DATASET_MAGIC, sizeof(DATASET_MAGIC)) != 0 ||
+        header.version != DATASET_VERSION || header.endian_tag != ENDIAN_TAG ||
+        header.file_size != file->size()) {
+        return nullptr;
+    }
+
+    const size_t size = file->size();
+    auto inside = [size](uint64_t offset, uint64_t bytes) {
+        return offset <= size && bytes <= size - offset;
+    };
+    // Размеры из заголовка проверяются до умножения, иначе оно может
+    // переполниться и пройти проверку границ
+    if (header.n_rows > size / sizeof(int32_t)) return nullptr;
+    if (!inside(sizeof(FileHeader), header.n_cols * sizeof(ColumnEntry)) ||
+        !inside(header.names_offset, header.names_bytes) ||
+        !inside(header.dict_offset, header.dict_bytes) ||
+        header.labels_offset % SECTION_ALIGNMENT != 0 ||
+        !inside(header.labels_offset, header.n_rows * sizeof(int32_t))) {
+        return nullptr;
+    }
+
+    std::shared_ptr<ColumnarDataset> dataset(new ColumnarDataset());
+    dataset->n_rows = header.n_rows;
+    dataset->source_size = header.source_size;
+    dataset->source_mtime = header.source_mtime;
+
+    std::vector<std::string> names;
+    if (!unpackStrings(base + header.names_offset, header.names_bytes, header.n_cols, names) ||
+        !unpackStrings(base + header.dict_offset, header.dict_bytes, header.n_labels,
+                       dataset->label_names)) {
+        return nullptr;
+    }
+
+    for (uint32_t j = 0; j < header.n_cols; ++j) {
+        ColumnEntry entry;
+        std::memcpy(&entry, base + sizeof(FileHeader) + j * sizeof(ColumnEntry), sizeof(entry));
+        ColumnType type = static_cast<ColumnType>(entry.type);
+        if (typeSize(type) == 0 || entry.offset % SECTION_ALIGNMENT != 0 ||
+            header.n_rows > size / typeSize(type) ||
+            entry.bytes != header.n_rows * typeSize(type) || !inside(entry.offset, entry.bytes)) {
+            return nullptr;
+        }
+        dataset->columns.push_back({type, base + entry.offset, entry.min, entry.max, names[j]});
+    }
+
+    dataset->label_codes = reinterpret_cast<const int32_t*>(base + header.labels_offset);
+    for (size_t i = 0; i < dataset->n_rows; ++i) {
+        int32_t code = dataset->label_codes[i];
+        if (code < 0 || static_cast<uint32_t>(code) >= header.n_labels) return nullptr;
+    }
+
+    dataset->file = file;
+    return dataset;
+}
+
+void ColumnarDataset::decodeColumn(size_t j, size_t begin, size_t end,
+                                   double* out, size_t stride) const {
+    const Column& column = columns[j];
+    switch (column.type) {
+        case ColumnType::UInt8: decodeAs<uint8_t>(column.data, begin, end, out, stride); break;
+        case ColumnType::Int32: decodeAs<int32_t>(column.data, begin, end, out, stride); break;
+        case ColumnType::Float32: decodeAs<float>(column.data, begin, end, out, stride); break;
+        case ColumnType::Float64: decodeAs<double>(column.data, begin, end, out, stride); break;
+    }
+}
+
+DataProcessor::FeatureTable ColumnarDataset::toTable(size_t num_threads) const {
+    DataProcessor::FeatureTable table;
+    table.features = FeatureMatrix(n_rows, columns.size());
+    table.label_ids.assign(label_codes, label_codes + n_rows);
+    table.label_names = label_names;
+    for (const auto& column : columns) {
+        table.feature_names.push_back(column.name);
+        table.ranges.mins.push_back(column.min);
+        table.ranges.maxs.push_back(column.max);
+    }
+    if (n_rows == 0) {
+        table.ranges = DataProcessor::NormalizationParams();
+        return table;
+    }
+
+    // Блок строк декодируется по всем столбцам, пока он в кэше
+    FeatureMatrix& matrix = table.features;
+    auto body = [&](size_t first_block, size_t last_block) {
+        for (size_t block = first_block; block < last_block; ++block) {
+            size_t begin = block * DECODE_BLOCK;
+            size_t end = std::min(n_rows, begin + DECODE_BLOCK);
+            for (size_t j = 0; j < columns.size(); ++j) {
+                decodeColumn(j, begin, end, matrix.row(begin) + j, matrix.stride());
+            }
+        }
+    };
+
+    size_t n_blocks = (n_rows + DECODE_BLOCK - 1) / DECODE_BLOCK;
+    std::unique_ptr<ThreadPool> own_pool;
+    ThreadPool* pool = nullptr;
+    if (num_threads == 0) {
+        pool = &ThreadPool::shared();
+    } else if (num_threads > 1) {
+        own_pool.reset(new ThreadPool(num_threads));
+        pool = own_pool.get();
+    }
+    if (pool && n_blocks > 1) {
+        pool->parallelFor(0, n_blocks, 1, body);
+    } else {
+        body(0, n_blocks);
+    }
+    return table;
+}
@@ -0,0 +1,74 @@
+#ifndef DATASET_CACHE_H
+#define DATASET_CACHE_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "data_processor.h"
+#include "mapped_file.h"
+
+// Столбцовый двоичный формат набора данных - кэш разобранного CSV.
+// Каждый признак хранится отдельным столбцом наименьшего типа, точно
+// представляющего все его значения; метки - номерами в словаре.
+// В заголовке - имена признаков и их минимум/максимум. Файл открывается
+// через mmap, столбцы читаются прямо из отображения.
+class ColumnarDataset {
+public:
+    enum class ColumnType : uint32_t {
+        UInt8 = 1,    // целые 0..255 (флаги, счетчики)
+        Int32 = 2,    // прочие целые
+        Float32 = 3,  // значения, точно представимые во float
+        Float64 = 4
+    };
+
+private:
+    struct Column {
+        ColumnType type;
+        const void* data;
+        double min;
+        double max;
+        std::string name;
+    };
+
+    std::shared_ptr<MappedFile> file;
+    std::vector<Column> columns;
+    const int32_t* label_codes;
+    std::vector<std::string> label_names;
+    size_t n_rows;
+    uint64_t source_size;
+    int64_t source_mtime;
+
+    ColumnarDataset();
+
+public:
+    // Запись таблицы; source_size/source_mtime - отметка исходного CSV
+    // для проверки актуальности кэша
+    static bool write(const std::string& path, const DataProcessor::FeatureTable& table,
+                      uint64_t source_size, int64_t source_mtime);
+    // nullptr, если файла нет или он поврежден
+    static std::shared_ptr<ColumnarDataset> open(const std::string& path);
+    // Размер и время изменения файла (нс); false, если файла нет
+    static bool sourceStamp(const std::string& path, uint64_t& size, int64_t& mtime);
+
+    size_t rows() const { return n_rows; }
+    size_t cols() const { return columns.size(); }
+    uint64_t sourceSize() const { return source_size; }
+    int64_t sourceMtime() const { return source_mtime; }
+
+    ColumnType columnType(size_t j) const { return columns[j].type; }
+    const void* columnData(size_t j) const { return columns[j].data; }
+    double columnMin(size_t j) const { return columns[j].min; }
+    double columnMax(size_t j) const { return columns[j].max; }
+    const std::string& featureName(size_t j) const { return columns[j].name; }
+    const int32_t* labelIds() const { return label_codes; }
+    const std::vector<std::string>& labelNames() const { return label_names; }
+
+    // Строки [begin, end) столбца j в out[0], out[stride], ...
+    void decodeColumn(size_t j, size_t begin, size_t end, double* out, size_t stride) const;
+    // Построчная таблица (признаки, метки, диапазоны); блоки строк
+    // декодируются параллельно. num_threads - как у loadCSVTable
+    DataProcessor::FeatureTable toTable(size_t num_threads = 0) const;
+};
+
+#endif
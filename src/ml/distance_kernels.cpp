@@ -0,0 +1,385 @@
+#include "distance_kernels.h"
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KNN_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+namespace {
+
+double squaredL2Scalar(const double* a, const double* b, size_t n) {
+    double sum = 0.0;
+    for (size_t i = 0; i < n; ++i) {
+        double diff = a[i] - b[i];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+void dotBlockScalar(const double* queries, size_t q_stride, size_t nq,
+                    const double* columns, size_t col_stride, size_t nr,
+                    size_t dim, double* out, size_t out_stride) {
+    for (size_t i = 0; i < nq; ++i) {
+        double* row = out + i * out_stride;
+        std::fill(row, row + nr, 0.0);
+        const double* q = queries + i * q_stride;
+        for (size_t j = 0; j < dim; ++j) {
+            const double* column = columns + j * col_stride;
+            double qj = q[j];
+            for (size_t r = 0; r < nr; ++r) {
+                row[r] += qj * column[r];
+            }
+        }
+    }
+}
+
+double squaredL2F32Scalar(const float* a, const float* b, size_t n) {
+    float sum = 0.0f;
+    for (size_t i = 0; i < n; ++i) {
+        float diff = a[i] - b[i];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+uint32_t squaredL2U8Scalar(const uint8_t* a, const uint8_t* b, size_t n) {
+    uint32_t sum = 0;
+    for (size_t i = 0; i < n; ++i) {
+        int diff = static_cast<int>(a[i]) - static_cast<int>(b[i]);
+        sum += static_cast<uint32_t>(diff * diff);
+    }
+    return sum;
+}
+
+#ifdef KNN_X86_DISPATCH
+
+__attribute__((target("sse2")))
+double squaredL2SSE2(const double* a, const double* b, size_t n) {
+    __m128d acc0 = _mm_setzero_pd();
+    __m128d acc1 = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128d d0 = _mm_sub_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i));
+        __m128d d1 = _mm_sub_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2));
+        acc0 = _mm_add_pd(acc0, _mm_mul_pd(d0, d0));
+        acc1 = _mm_add_pd(acc1, _mm_mul_pd(d1, d1));
+    }
+    acc0 = _mm_add_pd(acc0, acc1);
+    double lanes[2];
+    _mm_storeu_pd(lanes, acc0);
+    double sum = lanes[0] + lanes[1];
+    for (; i < n; ++i) {
+        double diff = a[i] - b[i];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+__attribute__((target("avx2,fma")))
+double squaredL2AVX2(const double* a, const double* b, size_t n) {
+    __m256d acc0 = _mm256_setzero_pd();
+    __m256d acc1 = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i));
+        __m256d d1 = _mm256_sub_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4));
+        acc0 = _mm256_fmadd_pd(d0, d0, acc0);
+        acc1 = _mm256_fmadd_pd(d1, d1, acc1);
+    }
+    for (; i + 4 <= n; i += 4) {
+        __m256d d0 = _mm256_sub_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i));
+        acc0 = _mm256_fmadd_pd(d0, d0, acc0);
+    }
+    acc0 = _mm256_add_pd(acc0, acc1);
+    __m128d half = _mm_add_pd(_mm256_castpd256_pd128(acc0), _mm256_extractf128_pd(acc0, 1));
+    double sum = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+    for (; i < n; ++i) {
+        double diff = a[i] - b[i];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+__attribute__((target("avx512f")))
+double squaredL2AVX512(const double* a, const double* b, size_t n) {
+    __m512d acc0 = _mm512_setzero_pd();
+    __m512d acc1 = _mm512_setzero_pd();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512d d0 = _mm512_sub_pd(_mm512_loadu_pd(a + i), _mm512_loadu_pd(b + i));
+        __m512d d1 = _mm512_sub_pd(_mm512_loadu_pd(a + i + 8), _mm512_loadu_pd(b + i + 8));
+        acc0 = _mm512_fmadd_pd(d0, d0, acc0);
+        acc1 = _mm512_fmadd_pd(d1, d1, acc1);
+    }
+    if (i < n) {
+        // Хвост короче 16 элементов - маскированные загрузки
+        size_t rest = n - i;
+        __mmask8 m0 = static_cast<__mmask8>(rest >= 8 ? 0xFF : (1u << rest) - 1);
+        __mmask8 m1 = static_cast<__mmask8>(rest > 8 ? (1u << (rest - 8)) - 1 : 0);
+        __m512d d0 = _mm512_sub_pd(_mm512_maskz_loadu_pd(m0, a + i),
+                                   _mm512_maskz_loadu_pd(m0, b + i));
+        acc0 = _mm512_fmadd_pd(d0, d0, acc0);
+        if (m1) {
+            __m512d d1 = _mm512_sub_pd(_mm512_maskz_loadu_pd(m1, a + i + 8),
+                                       _mm512_maskz_loadu_pd(m1, b + i + 8));
+            acc1 = _mm512_fmadd_pd(d1, d1, acc1);
+        }
+    }
+    alignas(64) double lanes[8];
+    _mm512_store_pd(lanes, _mm512_add_pd(acc0, acc1));
+    return ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) +
+           ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+}
+
+// Регистровый блок 4 запроса x 8 строк: 8 аккумуляторов,
+// на каждый признак - 2 загрузки столбца и 4 broadcast значения запроса
+__attribute__((target("avx2,fma")))
+void dotBlockAVX2(const double* queries, size_t q_stride, size_t nq,
+                  const double* columns, size_t col_stride, size_t nr,
+                  size_t dim, double* out, size_t out_stride) {
+    for (size_t i = 0; i < nq; i += 4) {
+        const double* q0 = queries + i * q_stride;
+        const double* q1 = q0 + q_stride;
+        const double* q2 = q1 + q_stride;
+        const double* q3 = q2 + q_stride;
+        for (size_t r = 0; r < nr; r += 8) {
+            __m256d a00 = _mm256_setzero_pd(), a01 = _mm256_setzero_pd();
+            __m256d a10 = _mm256_setzero_pd(), a11 = _mm256_setzero_pd();
+            __m256d a20 = _mm256_setzero_pd(), a21 = _mm256_setzero_pd();
+            __m256d a30 = _mm256_setzero_pd(), a31 = _mm256_setzero_pd();
+            const double* column = columns + r;
+            for (size_t j = 0; j < dim; ++j, column += col_stride) {
+                __m256d x0 = _mm256_loadu_pd(column);
+                __m256d x1 = _mm256_loadu_pd(column + 4);
+                __m256d b = _mm256_broadcast_sd(q0 + j);
+                a00 = _mm256_fmadd_pd(b, x0, a00);
+                a01 = _mm256_fmadd_pd(b, x1, a01);
+                b = _mm256_broadcast_sd(q1 + j);
+                a10 = _mm256_fmadd_pd(b, x0, a10);
+                a11 = _mm256_fmadd_pd(b, x1, a11);
+                b = _mm256_broadcast_sd(q2 + j);
+                a20 = _mm256_fmadd_pd(b, x0, a20);
+                a21 = _mm256_fmadd_pd(b, x1, a21);
+                b = _mm256_broadcast_sd(q3 + j);
+                a30 = _mm256_fmadd_pd(b, x0, a30);
+                a31 = _mm256_fmadd_pd(b, x1, a31);
+            }
+            double* o = out + i * out_stride + r;
+            _mm256_storeu_pd(o, a00);
+            _mm256_storeu_pd(o + 4, a01);
+            o += out_stride;
+            _mm256_storeu_pd(o, a10);
+            _mm256_storeu_pd(o + 4, a11);
+            o += out_stride;
+            _mm256_storeu_pd(o, a20);
+            _mm256_storeu_pd(o + 4, a21);
+            o += out_stride;
+            _mm256_storeu_pd(o, a30);
+            _mm256_storeu_pd(o + 4, a31);
+        }
+    }
+}
+
+// Тот же блок 4 x 8 на одном 512-битном регистре на запрос
+__attribute__((target("avx512f")))
+void dotBlockAVX512(const double* queries, size_t q_stride, size_t nq,
+                    const double* columns, size_t col_stride, size_t nr,
+                    size_t dim, double* out, size_t out_stride) {
+    for (size_t i = 0; i < nq; i += 4) {
+        const double* q0 = queries + i * q_stride;
+        const double* q1 = q0 + q_stride;
+        const double* q2 = q1 + q_stride;
+        const double* q3 = q2 + q_stride;
+        size_t r = 0;
+        for (; r + 16 <= nr; r += 16) {
+            __m512d a00 = _mm512_setzero_pd(), a01 = _mm512_setzero_pd();
+            __m512d a10 = _mm512_setzero_pd(), a11 = _mm512_setzero_pd();
+            __m512d a20 = _mm512_setzero_pd(), a21 = _mm512_setzero_pd();
+            __m512d a30 = _mm512_setzero_pd(), a31 = _mm512_setzero_pd();
+            const double* column = columns + r;
+            for (size_t j = 0; j < dim; ++j, column += col_stride) {
+                __m512d x0 = _mm512_loadu_pd(column);
+                __m512d x1 = _mm512_loadu_pd(column + 8);
+                __m512d b = _mm512_set1_pd(q0[j]);
+                a00 = _mm512_fmadd_pd(b, x0, a00);
+                a01 = _mm512_fmadd_pd(b, x1, a01);
+                b = _mm512_set1_pd(q1[j]);
+                a10 = _mm512_fmadd_pd(b, x0, a10);
+                a11 = _mm512_fmadd_pd(b, x1, a11);
+                b = _mm512_set1_pd(q2[j]);
+                a20 = _mm512_fmadd_pd(b, x0, a20);
+                a21 = _mm512_fmadd_pd(b, x1, a21);
+                b = _mm512_set1_pd(q3[j]);
+                a30 = _mm512_fmadd_pd(b, x0, a30);
+                a31 = _mm512_fmadd_pd(b, x1, a31);
+            }
+            double* o = out + i * out_stride + r;
+            _mm512_storeu_pd(o, a00);
+            _mm512_storeu_pd(o + 8, a01);
+            o += out_stride;
+            _mm512_storeu_pd(o, a10);
+            _mm512_storeu_pd(o + 8, a11);
+            o += out_stride;
+            _mm512_storeu_pd(o, a20);
+            _mm512_storeu_pd(o + 8, a21);
+            o += out_stride;
+            _mm512_storeu_pd(o, a30);
+            _mm512_storeu_pd(o + 8, a31);
+        }
+        if (r < nr) {
+            __m512d a0 = _mm512_setzero_pd(), a1 = _mm512_setzero_pd();
+            __m512d a2 = _mm512_setzero_pd(), a3 = _mm512_setzero_pd();
+            const double* column = columns + r;
+            for (size_t j = 0; j < dim; ++j, column += col_stride) {
+                __m512d x = _mm512_loadu_pd(column);
+                a0 = _mm512_fmadd_pd(_mm512_set1_pd(q0[j]), x, a0);
+                a1 = _mm512_fmadd_pd(_mm512_set1_pd(q1[j]), x, a1);
+                a2 = _mm512_fmadd_pd(_mm512_set1_pd(q2[j]), x, a2);
+                a3 = _mm512_fmadd_pd(_mm512_set1_pd(q3[j]), x, a3);
+            }
+            double* o = out + i * out_stride + r;
+            _mm512_storeu_pd(o, a0);
+            _mm512_storeu_pd(o + out_stride, a1);
+            _mm512_storeu_pd(o + 2 * out_stride, a2);
+            _mm512_storeu_pd(o + 3 * out_stride, a3);
+        }
+    }
+}
+
+__attribute__((target("avx2,fma")))
+double squaredL2F32AVX2(const float* a, const float* b, size_t n) {
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        __m256 d1 = _mm256_sub_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8));
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm256_fmadd_ps(d1, d1, acc1);
+    }
+    for (; i + 8 <= n; i += 8) {
+        __m256 d0 = _mm256_sub_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i));
+        acc0 = _mm256_fmadd_ps(d0, d0, acc0);
+    }
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, _mm256_add_ps(acc0, acc1));
+    float sum = ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) +
+                ((lanes[4] + lanes[5]) + (lanes[6] + lanes[7]));
+    for (; i < n; ++i) {
+        float diff = a[i] - b[i];
+        sum += diff * diff;
+    }
+    return sum;
+}
+
+__attribute__((target("avx512f")))
+double squaredL2F32AVX512(const float* a, const float* b, size_t n) {
+    __m512 acc0 = _mm512_setzero_ps();
+    __m512 acc1 = _mm512_setzero_ps();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m512 d0 = _mm512_sub_ps(_mm512_loadu_ps(a + i), _mm512_loadu_ps(b + i));
+        __m512 d1 = _mm512_sub_ps(_mm512_loadu_ps(a + i + 16), _mm512_loadu_ps(b + i + 16));
+        acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+        acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+    }
+    if (i < n) {
+        size_t rest = n - i;
+        __mmask16 m0 = static_cast<__mmask16>(rest >= 16 ? 0xFFFF : (1u << rest) - 1);
+        __mmask16 m1 = static_cast<__mmask16>(rest > 16 ? (1u << (rest - 16)) - 1 : 0);
+        __m512 d0 = _mm512_sub_ps(_mm512_maskz_loadu_ps(m0, a + i),
+                                  _mm512_maskz_loadu_ps(m0, b + i));
+        acc0 = _mm512_fmadd_ps(d0, d0, acc0);
+        if (m1) {
+            __m512 d1 = _mm512_sub_ps(_mm512_maskz_loadu_ps(m1, a + i + 16),
+                                      _mm512_maskz_loadu_ps(m1, b + i + 16));
+            acc1 = _mm512_fmadd_ps(d1, d1, acc1);
+        }
+    }
+    alignas(64) float lanes[16];
+    _mm512_store_ps(lanes, _mm512_add_ps(acc0, acc1));
+    float sum = 0.0f;
+    for (int l = 0; l < 16; ++l) {
+        sum += lanes[l];
+    }
+    return sum;
+}
+
+// uint8: расширение до 16 бит и madd дает 32-битные суммы квадратов пар
+__attribute__((target("avx2")))
+uint32_t squaredL2U8AVX2(const uint8_t* a, const uint8_t* b, size_t n) {
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i va = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+        __m256i vb = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+        __m256i diff = _mm256_sub_epi16(va, vb);
+        acc = _mm256_add_epi32(acc, _mm256_madd_epi16(diff, diff));
+    }
+    alignas(32) uint32_t lanes[8];
+    _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+    uint32_t sum = 0;
+    for (int l = 0; l < 8; ++l) {
+        sum += lanes[l];
+    }
+    for (; i < n; ++i) {
+        int diff = static_cast<int>(a[i]) - static_cast<int>(b[i]);
+        sum += static_cast<uint32_t>(diff * diff);
+    }
+    return sum;
+}
+
+#endif
+
+// Для SSE2 ядра float/uint8 - скалярные: базовый x86-64 и так SSE2,
+// компилятор векторизует их сам. Для AVX-512 uint8-ядро берется из AVX2,
+// чтобы не требовать AVX-512BW.
+const DistanceKernels SCALAR_KERNELS = {
+    SimdLevel::Scalar, "scalar", squaredL2Scalar, dotBlockScalar,
+    squaredL2F32Scalar, squaredL2U8Scalar};
+#ifdef KNN_X86_DISPATCH
+const DistanceKernels SSE2_KERNELS = {
+    SimdLevel::SSE2, "sse2", squaredL2SSE2, dotBlockScalar,
+    squaredL2F32Scalar, squaredL2U8Scalar};
+const DistanceKernels AVX2_KERNELS = {
+    SimdLevel::AVX2, "avx2", squaredL2AVX2, dotBlockAVX2,
+    squaredL2F32AVX2, squaredL2U8AVX2};
+const DistanceKernels AVX512_KERNELS = {
+    SimdLevel::AVX512, "avx512", squaredL2AVX512, dotBlockAVX512,
+    squaredL2F32AVX512, squaredL2U8AVX2};
+#endif
+
+} // namespace
+
+SimdLevel detectSimdLevel() {
+#ifdef KNN_X86_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return SimdLevel::AVX512;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse2")) return SimdLevel::SSE2;
+#endif
+    return SimdLevel::Scalar;
+}
+
+const DistanceKernels& distanceKernelsFor(SimdLevel level) {
+#ifdef KNN_X86_DISPATCH
+    // Уровень выше поддерживаемого процессором привел бы к SIGILL
+    SimdLevel supported = detectSimdLevel();
+    if (static_cast<int>(level) > static_cast<int>(supported)) level = supported;
+    switch (level) {
+        case SimdLevel::AVX512: return AVX512_KERNELS;
+        case SimdLevel::AVX2: return AVX2_KERNELS;
+        case SimdLevel::SSE2: return SSE2_KERNELS;
+        default: break;
+    }
+#else
+    (void)level;
+#endif
+    return SCALAR_KERNELS;
+}
+
+const DistanceKernels& distanceKernels() {
+    static const DistanceKernels& selected = distanceKernelsFor(detectSimdLevel());
+    return selected;
+}
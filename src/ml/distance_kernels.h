@@ -0,0 +1,51 @@
+#ifndef DISTANCE_KERNELS_H
+#define DISTANCE_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Уровень набора SIMD-инструкций, доступный на текущем процессоре
+enum class SimdLevel {
+    Scalar,
+    SSE2,
+    AVX2,
+    AVX512
+};
+
+// Квадрат евклидова расстояния между двумя векторами длины n
+using SquaredL2Fn = double (*)(const double* a, const double* b, size_t n);
+
+// То же для признаков пониженной точности: float32 и квантованных uint8
+// (для uint8 результат - целый квадрат расстояния в единицах шага квантования)
+using SquaredL2F32Fn = double (*)(const float* a, const float* b, size_t n);
+using SquaredL2U8Fn = uint32_t (*)(const uint8_t* a, const uint8_t* b, size_t n);
+
+// Блок скалярных произведений (микроядро GEMM):
+// out[i * out_stride + r] = sum_j queries[i * q_stride + j] * columns[j * col_stride + r]
+// для i < nq, r < nr. Обучающие строки передаются в column-major виде,
+// поэтому вектор регистра покрывает несколько строк сразу.
+// Требования: nq кратно 4, nr кратно 8 (буферы дополнены нулями).
+using DotBlockFn = void (*)(const double* queries, size_t q_stride, size_t nq,
+                            const double* columns, size_t col_stride, size_t nr,
+                            size_t dim, double* out, size_t out_stride);
+
+struct DistanceKernels {
+    SimdLevel level;
+    const char* name;
+    SquaredL2Fn squaredL2;
+    DotBlockFn dotBlock;
+    SquaredL2F32Fn squaredL2F32;
+    SquaredL2U8Fn squaredL2U8;
+};
+
+// Определение возможностей процессора во время выполнения
+SimdLevel detectSimdLevel();
+
+// Ядра для заданного уровня (если он не поддерживается сборкой или
+// процессором - ближайший доступный более низкий уровень)
+const DistanceKernels& distanceKernelsFor(SimdLevel level);
+
+// Ядра, выбранные один раз при первом вызове по detectSimdLevel()
+const DistanceKernels& distanceKernels();
+
+#endif
@@ -0,0 +1,196 @@
+#ifndef FEATURE_MATRIX_H
+#define FEATURE_MATRIX_H
+
+#include <vector>
+#include <memory>
+#include <new>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
+
+// Выравнивание строк: одна кэш-линия, достаточно для AVX-512
+constexpr size_t FEATURE_ALIGNMENT = 64;
+
+// Непрерывный выровненный буфер тривиально копируемых элементов.
+// Буфер либо владеет памятью, либо является представлением (view) чужой
+// памяти, например отображенного файла модели; владелец такой памяти
+// удерживается через keep_alive. Копия представления - то же представление.
+template <typename T>
+class AlignedBuffer {
+private:
+    struct Deleter {
+        void operator()(T* p) const {
+            ::operator delete(p, std::align_val_t(FEATURE_ALIGNMENT));
+        }
+    };
+
+    std::unique_ptr<T, Deleter> owned;
+    std::shared_ptr<const void> keep_alive;
+    T* ptr;
+    size_t count;
+
+public:
+    AlignedBuffer() : ptr(nullptr), count(0) {}
+
+    // Представление n элементов по адресу data без копирования.
+    // Память только читается; owner живет, пока живо представление.
+    static AlignedBuffer view(const void* data, size_t n, std::shared_ptr<const void> owner) {
+        AlignedBuffer result;
+        result.ptr = static_cast<T*>(const_cast<void*>(data));
+        result.count = n;
+        result.keep_alive = std::move(owner);
+        return result;
+    }
+
+    bool isView() const { return ptr != nullptr && !owned; }
+
+    explicit AlignedBuffer(size_t n) : ptr(nullptr), count(n) {
+        if (n > 0) {
+            ptr = static_cast<T*>(::operator new(n * sizeof(T),
+                                                 std::align_val_t(FEATURE_ALIGNMENT)));
+            std::memset(static_cast<void*>(ptr), 0, n * sizeof(T));
+            owned.reset(ptr);
+        }
+    }
+
+    AlignedBuffer(const AlignedBuffer& other) : ptr(nullptr), count(0) {
+        if (other.isView()) {
+            keep_alive = other.keep_alive;
+            ptr = other.ptr;
+            count = other.count;
+        } else if (other.count > 0) {
+            *this = AlignedBuffer(other.count);
+            std::memcpy(static_cast<void*>(ptr), other.ptr, count * sizeof(T));
+        }
+    }
+
+    AlignedBuffer& operator=(const AlignedBuffer& other) {
+        if (this != &other) {
+            AlignedBuffer copy(other);
+            *this = std::move(copy);
+        }
+        return *this;
+    }
+
+    AlignedBuffer(AlignedBuffer&& other) noexcept
+        : owned(std::move(other.owned)), keep_alive(std::move(other.keep_alive)),
+          ptr(other.ptr), count(other.count) {
+        other.ptr = nullptr;
+        other.count = 0;
+    }
+
+    AlignedBuffer& operator=(AlignedBuffer&& other) noexcept {
+        if (this != &other) {
+            owned = std::move(other.owned);
+            keep_alive = std::move(other.keep_alive);
+            ptr = other.ptr;
+            count = other.count;
+            other.ptr = nullptr;
+            other.count = 0;
+        }
+        return *this;
+    }
+
+    T* data() { return ptr; }
+    const T* data() const { return ptr; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T& operator[](size_t i) { return ptr[i]; }
+    const T& operator[](size_t i) const { return ptr[i]; }
+};
+
+// Матрица признаков: строки лежат подряд, каждая выровнена и дополнена
+// нулями до кратной FEATURE_ALIGNMENT длины. Нулевой хвост не меняет
+// расстояния, поэтому SIMD-ядра могут читать строку целыми регистрами.
+// Опционально хранится транспонированная (column-major) копия.
+template <typename T>
+class AlignedMatrix {
+private:
+    AlignedBuffer<T> storage;
+    AlignedBuffer<T> columns;
+    size_t n_rows;
+    size_t n_cols;
+    size_t row_stride;
+    size_t column_stride;
+
+public:
+    AlignedMatrix() : n_rows(0), n_cols(0), row_stride(0), column_stride(0) {}
+
+    AlignedMatrix(size_t rows, size_t cols)
+        : storage(rows * paddedWidth(cols)),
+          n_rows(rows), n_cols(cols),
+          row_stride(paddedWidth(cols)), column_stride(0) {}
+
+    // Длина строки с учетом выравнивающего хвоста
+    static size_t paddedWidth(size_t cols) {
+        const size_t per_line = FEATURE_ALIGNMENT / sizeof(T);
+        return (cols + per_line - 1) / per_line * per_line;
+    }
+
+    // Матрица поверх готовых буферов (например, из отображенного файла)
+    static AlignedMatrix fromBuffers(AlignedBuffer<T> rows_buffer, size_t rows, size_t cols,
+                                     size_t stride, AlignedBuffer<T> columns_buffer = {},
+                                     size_t col_stride = 0) {
+        AlignedMatrix result;
+        result.storage = std::move(rows_buffer);
+        result.columns = std::move(columns_buffer);
+        result.n_rows = rows;
+        result.n_cols = cols;
+        result.row_stride = stride;
+        result.column_stride = result.columns.empty() ? 0 : col_stride;
+        return result;
+    }
+
+    template <typename U>
+    static AlignedMatrix fromRows(const std::vector<std::vector<U>>& rows) {
+        size_t cols = rows.empty() ? 0 : rows[0].size();
+        AlignedMatrix result(rows.size(), cols);
+        for (size_t i = 0; i < rows.size(); ++i) {
+            T* dst = result.row(i);
+            size_t n = std::min(cols, rows[i].size());
+            for (size_t j = 0; j < n; ++j) {
+                dst[j] = static_cast<T>(rows[i][j]);
+            }
+        }
+        return result;
+    }
+
+    size_t rows() const { return n_rows; }
+    size_t cols() const { return n_cols; }
+    size_t stride() const { return row_stride; }
+    bool empty() const { return n_rows == 0; }
+
+    T* data() { return storage.data(); }
+    const T* data() const { return storage.data(); }
+    T* row(size_t i) { return storage.data() + i * row_stride; }
+    const T* row(size_t i) const { return storage.data() + i * row_stride; }
+    T& at(size_t i, size_t j) { return storage[i * row_stride + j]; }
+    const T& at(size_t i, size_t j) const { return storage[i * row_stride + j]; }
+
+    // Построение column-major копии (столбец j непрерывен по всем строкам)
+    void buildColumnMajor() {
+        column_stride = paddedWidth(n_rows);
+        columns = AlignedBuffer<T>(n_cols * column_stride);
+        for (size_t i = 0; i < n_rows; ++i) {
+            const T* src = row(i);
+            for (size_t j = 0; j < n_cols; ++j) {
+                columns[j * column_stride + i] = src[j];
+            }
+        }
+    }
+
+    void dropColumnMajor() {
+        columns = AlignedBuffer<T>();
+        column_stride = 0;
+    }
+
+    bool hasColumnMajor() const { return !columns.empty(); }
+    const AlignedBuffer<T>& rowBuffer() const { return storage; }
+    const AlignedBuffer<T>& columnBuffer() const { return columns; }
+    size_t columnStride() const { return column_stride; }
+    const T* column(size_t j) const { return columns.data() + j * column_stride; }
+};
+
+using FeatureMatrix = AlignedMatrix<double>;
+
+#endif
@@ -0,0 +1,188 @@
+#include "feature_scaler.h"
+#include "thread_pool.h"
+#include <cmath>
+#include <limits>
+#include <memory>
+
+namespace {
+
+const size_t SCALER_BLOCK = 4096;
+
+// Статистики блока строк: диапазон, среднее и сумма квадратов отклонений
+struct BlockStats {
+    size_t count = 0;
+    std::vector<double> mins, maxs, means, m2;
+
+    void reset(size_t n_cols) {
+        count = 0;
+        mins.assign(n_cols, std::numeric_limits<double>::max());
+        maxs.assign(n_cols, std::numeric_limits<double>::lowest());
+        means.assign(n_cols, 0.0);
+        m2.assign(n_cols, 0.0);
+    }
+
+    void add(const double* row) {
+        ++count;
+        double inv = 1.0 / static_cast<double>(count);
+        for (size_t j = 0; j < means.size(); ++j) {
+            double x = row[j];
+            mins[j] = std::min(mins[j], x);
+            maxs[j] = std::max(maxs[j], x);
+            double delta = x - means[j];
+            means[j] += delta * inv;
+            m2[j] += delta * (x - means[j]);
+        }
+    }
+
+    // Объединение по формуле Чана: результат равен проходу по обоим блокам
+    void merge(const BlockStats& other) {
+        if (other.count == 0) return;
+        if (count == 0) {
+            *this = other;
+            return;
+        }
+        double n_a = static_cast<double>(count);
+        double n_b = static_cast<double>(other.count);
+        double n = n_a + n_b;
+        for (size_t j = 0; j < means.size(); ++j) {
+            mins[j] = std::min(mins[j], other.mins[j]);
+            maxs[j] = std::max(maxs[j], other.maxs[j]);
+            double delta = other.means[j] - means[j];
+            means[j] += delta * n_b / n;
+            m2[j] += other.m2[j] + delta * delta * n_a * n_b / n;
+        }
+        count += other.count;
+    }
+};
+
+// Выполнение body по блокам строк: 0 - общий пул, 1 - последовательно
+void forEachBlock(size_t n_rows, size_t num_threads,
+                  const std::function<void(size_t, size_t, size_t)>& body) {
+    size_t n_blocks = (n_rows + SCALER_BLOCK - 1) / SCALER_BLOCK;
+    auto run = [&](size_t first, size_t last) {
+        for (size_t block = first; block < last; ++block) {
+            size_t begin = block * SCALER_BLOCK;
+            body(block, begin, std::min(n_rows, begin + SCALER_BLOCK));
+        }
+    };
+
+    std::unique_ptr<ThreadPool> own_pool;
+    ThreadPool* pool = nullptr;
+    if (num_threads == 0) {
+        pool = &ThreadPool::shared();
+    } else if (num_threads > 1) {
+        own_pool.reset(new ThreadPool(num_threads));
+        pool = own_pool.get();
+    }
+    if (pool && n_blocks > 1) {
+        pool->parallelFor(0, n_blocks, 1, run);
+    } else {
+        run(0, n_blocks);
+    }
+}
+
+} // namespace
+
+FeatureScaler::FeatureScaler(Method method) : method(method), num_threads(0) {}
+
+void FeatureScaler::setMethod(Method m) {
+    method = m;
+    updateCoefficients();
+}
+
+void FeatureScaler::updateCoefficients() {
+    size_t n = mins.size();
+    offsets.assign(n, 0.0);
+    scales.assign(n, 0.0);
+    for (size_t j = 0; j < n; ++j) {
+        // Постоянный признак переводится в 0, как в normalizeFeatures
+        if (method == Method::MinMax) {
+            double range = maxs[j] - mins[j];
+            offsets[j] = mins[j];
+            scales[j] = range > 0 ? 1.0 / range : 0.0;
+        } else {
+            offsets[j] = j < means.size() ? means[j] : 0.0;
+            double deviation = j < stddevs.size() ? stddevs[j] : 0.0;
+            scales[j] = deviation > 0 ? 1.0 / deviation : 0.0;
+        }
+    }
+}
+
+void FeatureScaler::fitRows(size_t n_rows, size_t n_cols,
+                            const std::function<const double*(size_t)>& row) {
+    size_t n_blocks = (n_rows + SCALER_BLOCK - 1) / SCALER_BLOCK;
+    std::vector<BlockStats> blocks(n_blocks);
+    forEachBlock(n_rows, num_threads, [&](size_t block, size_t begin, size_t end) {
+        blocks[block].reset(n_cols);
+        for (size_t i = begin; i < end; ++i) {
+            blocks[block].add(row(i));
+        }
+    });
+
+    BlockStats total;
+    total.reset(n_cols);
+    for (const auto& block : blocks) {
+        total.merge(block);
+    }
+
+    mins = total.mins;
+    maxs = total.maxs;
+    means = total.means;
+    stddevs.assign(n_cols, 0.0);
+    for (size_t j = 0; j < n_cols; ++j) {
+        stddevs[j] = total.count > 0 ? std::sqrt(total.m2[j] / total.count) : 0.0;
+    }
+    if (total.count == 0) {
+        mins.assign(n_cols, 0.0);
+        maxs.assign(n_cols, 0.0);
+    }
+    updateCoefficients();
+}
+
+void FeatureScaler::fit(const FeatureMatrix& features) {
+    fitRows(features.rows(), features.cols(),
+            [&features](size_t i) { return features.row(i); });
+}
+
+void FeatureScaler::fit(const std::vector<std::vector<double>>& features) {
+    size_t n_cols = features.empty() ? 0 : features[0].size();
+    fitRows(features.size(), n_cols,
+            [&features](size_t i) { return features[i].data(); });
+}
+
+void FeatureScaler::fitRanges(const DataProcessor::NormalizationParams& params) {
+    mins = params.mins;
+    maxs = params.maxs;
+    means.clear();
+    stddevs.clear();
+    method = Method::MinMax;
+    updateCoefficients();
+}
+
+void FeatureScaler::transform(FeatureMatrix& features) const {
+    // Хвост выравнивания не трогается и остается нулевым
+    size_t n = std::min(features.cols(), offsets.size());
+    forEachBlock(features.rows(), num_threads, [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            transformRow(features.row(i), n);
+        }
+    });
+    if (features.hasColumnMajor()) {
+        features.buildColumnMajor();
+    }
+}
+
+void FeatureScaler::transform(std::vector<std::vector<double>>& features) const {
+    forEachBlock(features.size(), num_threads, [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            transformRow(features[i].data(), features[i].size());
+        }
+    });
+}
+
+DataProcessor::NormalizationParams FeatureScaler::ranges() const {
+    DataProcessor::NormalizationParams params;
+    params.mins = mins;
+    params.maxs = maxs;
+    return params;
+}
@@ -0,0 +1,74 @@
+#ifndef FEATURE_SCALER_H
+#define FEATURE_SCALER_H
+
+#include <vector>
+#include <cstddef>
+#include <functional>
+#include <algorithm>
+#include "feature_matrix.h"
+#include "data_processor.h"
+
+// Масштабирование признаков с запоминаемыми параметрами: fit считает
+// статистики на обучающей выборке, transform применяет их к любым данным
+// (тестовым, живому трафику). Оба метода - преобразование вида
+// x' = (x - offset) * scale, поэтому внутренний цикл векторизуется,
+// а строки обрабатываются параллельно блоками.
+class FeatureScaler {
+public:
+    enum class Method {
+        MinMax,   // в [0, 1] по минимуму и максимуму
+        ZScore    // нулевое среднее и единичное стандартное отклонение
+    };
+
+private:
+    Method method;
+    std::vector<double> offsets;
+    std::vector<double> scales;
+    // Статистики обучающей выборки
+    std::vector<double> mins;
+    std::vector<double> maxs;
+    std::vector<double> means;
+    std::vector<double> stddevs;
+    size_t num_threads;
+
+    void updateCoefficients();
+    void fitRows(size_t n_rows, size_t n_cols, const std::function<const double*(size_t)>& row);
+
+public:
+    explicit FeatureScaler(Method method = Method::MinMax);
+
+    void setMethod(Method m);
+    Method scalingMethod() const { return method; }
+    // 0 - общий пул, 1 - последовательно, n - свой пул из n потоков
+    void setNumThreads(size_t n) { num_threads = n; }
+
+    void fit(const FeatureMatrix& features);
+    void fit(const std::vector<std::vector<double>>& features);
+    // Min-max по заранее известным диапазонам (столбцовый кэш, сохраненная
+    // модель) без прохода по данным; метод переключается на MinMax
+    void fitRanges(const DataProcessor::NormalizationParams& ranges);
+
+    void transform(FeatureMatrix& features) const;
+    void transform(std::vector<std::vector<double>>& features) const;
+    // Одна строка из n значений; используется и при разборе CSV
+    void transformRow(double* row, size_t n) const {
+        const double* offset = offsets.data();
+        const double* scale = scales.data();
+        n = std::min(n, offsets.size());
+        for (size_t j = 0; j < n; ++j) {
+            row[j] = (row[j] - offset[j]) * scale[j];
+        }
+    }
+
+    void fitTransform(FeatureMatrix& features) { fit(features); transform(features); }
+    void fitTransform(std::vector<std::vector<double>>& features) { fit(features); transform(features); }
+
+    bool fitted() const { return !offsets.empty(); }
+    size_t size() const { return offsets.size(); }
+    // Диапазоны обучающей выборки в формате DataProcessor (для сохранения в модели)
+    DataProcessor::NormalizationParams ranges() const;
+    const std::vector<double>& featureMeans() const { return means; }
+    const std::vector<double>& featureStddevs() const { return stddevs; }
+};
+
+#endif
@@ -0,0 +1,329 @@
+#include "hnsw_index.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <functional>
+#include <cstring>
+
+namespace {
+
+// Отметки посещенных узлов; сбрасываются сменой эпохи, а не очисткой
+struct VisitedSet {
+    std::vector<uint32_t> marks;
+    uint32_t epoch = 0;
+
+    void reset(size_t n) {
+        if (marks.size() < n) {
+            marks.assign(n, 0);
+            epoch = 0;
+        }
+        if (++epoch == 0) {
+            std::fill(marks.begin(), marks.end(), 0);
+            epoch = 1;
+        }
+    }
+
+    bool visit(uint32_t node) {
+        if (marks[node] == epoch) return false;
+        marks[node] = epoch;
+        return true;
+    }
+};
+
+VisitedSet& threadVisited() {
+    static thread_local VisitedSet visited;
+    return visited;
+}
+
+} // namespace
+
+HNSWIndex::HNSWIndex(const HNSWParams& p)
+    : params(p), level_mult(0.0), entry_point(0), max_level(-1), n_nodes(0), header() {
+    params.M = std::max<size_t>(2, params.M);
+    params.ef_construction = std::max(params.ef_construction, params.M);
+    level_mult = 1.0 / std::log(static_cast<double>(params.M));
+}
+
+void HNSWIndex::neighboursOf(uint32_t node, int level, const uint32_t*& begin,
+                             const uint32_t*& end) const {
+    if (!links.empty()) {
+        const std::vector<uint32_t>& list = links[node][level];
+        begin = list.data();
+        end = list.data() + list.size();
+        return;
+    }
+    size_t slot = node_start[node] + level;
+    begin = link_data.data() + level_start[slot];
+    end = link_data.data() + level_start[slot + 1];
+}
+
+void HNSWIndex::flatten() {
+    std::vector<uint32_t> nodes_flat(n_nodes + 1);
+    std::vector<uint32_t> levels_flat;
+    std::vector<uint32_t> data_flat;
+    for (size_t node = 0; node < n_nodes; ++node) {
+        nodes_flat[node] = static_cast<uint32_t>(levels_flat.size());
+        for (const auto& list : links[node]) {
+            levels_flat.push_back(static_cast<uint32_t>(data_flat.size()));
+            data_flat.insert(data_flat.end(), list.begin(), list.end());
+        }
+    }
+    nodes_flat[n_nodes] = static_cast<uint32_t>(levels_flat.size());
+    levels_flat.push_back(static_cast<uint32_t>(data_flat.size()));
+
+    auto copy = [](const std::vector<uint32_t>& values) {
+        AlignedBuffer<uint32_t> buffer(values.size());
+        std::copy(values.begin(), values.end(), buffer.data());
+        return buffer;
+    };
+    node_start = copy(nodes_flat);
+    level_start = copy(levels_flat);
+    link_data = copy(data_flat);
+    links.clear();
+    links.shrink_to_fit();
+
+    header = {params.M, params.ef_construction, params.ef_search, entry_point, max_level};
+}
+
+std::vector<NeighbourIndex::Blob> HNSWIndex::exportBlobs() const {
+    return {{&header, sizeof(header)},
+            {node_start.data(), node_start.size() * sizeof(uint32_t)},
+            {level_start.data(), level_start.size() * sizeof(uint32_t)},
+            {link_data.data(), link_data.size() * sizeof(uint32_t)}};
+}
+
+bool HNSWIndex::importBlobs(const std::vector<Blob>& blobs, std::shared_ptr<const void> owner,
+                            const FeatureMatrix& points) {
+    size_t n_points = points.rows();
+    if (blobs.size() != 4 || blobs[0].bytes != sizeof(GraphHeader) ||
+        blobs[1].bytes != (n_points + 1) * sizeof(uint32_t) ||
+        blobs[2].bytes % sizeof(uint32_t) != 0 || blobs[2].bytes == 0 ||
+        blobs[3].bytes % sizeof(uint32_t) != 0) {
+        return false;
+    }
+    GraphHeader new_header;
+    std::memcpy(&new_header, blobs[0].data, sizeof(new_header));
+    auto nodes = AlignedBuffer<uint32_t>::view(blobs[1].data, n_points + 1, owner);
+    auto levels = AlignedBuffer<uint32_t>::view(blobs[2].data, blobs[2].bytes / sizeof(uint32_t), owner);
+    auto data = AlignedBuffer<uint32_t>::view(blobs[3].data, blobs[3].bytes / sizeof(uint32_t), owner);
+
+    // Смещения возрастают и заканчиваются на размерах следующих массивов;
+    // у каждого узла есть хотя бы слой 0
+    if (nodes[0] != 0 || nodes[n_points] != levels.size() - 1 ||
+        levels[0] != 0 || levels[levels.size() - 1] != data.size()) {
+        return false;
+    }
+    for (size_t node = 0; node < n_points; ++node) {
+        if (nodes[node + 1] <= nodes[node]) return false;
+    }
+    for (size_t slot = 0; slot + 1 < levels.size(); ++slot) {
+        if (levels[slot + 1] < levels[slot]) return false;
+    }
+    // Связь на уровне l ведет в существующий узел, у которого есть уровень l
+    for (size_t node = 0; node < n_points; ++node) {
+        for (uint32_t slot = nodes[node]; slot < nodes[node + 1]; ++slot) {
+            uint32_t level = slot - nodes[node];
+            for (uint32_t i = levels[slot]; i < levels[slot + 1]; ++i) {
+                uint32_t other = data[i];
+                if (other >= n_points || nodes[other + 1] - nodes[other] <= level) return false;
+            }
+        }
+    }
+    if (n_points == 0 ? new_header.max_level >= 0
+                      : new_header.max_level < 0 || new_header.entry_point >= n_points ||
+                        nodes[new_header.entry_point + 1] - nodes[new_header.entry_point] <=
+                            static_cast<uint32_t>(new_header.max_level)) {
+        return false;
+    }
+
+    // Ширина поиска больше числа узлов ничего не дает, но резервирует память
+    new_header.ef_search = std::min<uint64_t>(new_header.ef_search, std::max<size_t>(1, n_points));
+    header = new_header;
+    params.M = std::max<uint64_t>(2, header.M);
+    params.ef_construction = header.ef_construction;
+    params.ef_search = header.ef_search;
+    level_mult = 1.0 / std::log(static_cast<double>(params.M));
+    entry_point = header.entry_point;
+    max_level = header.max_level;
+
+    links.clear();
+    node_start = std::move(nodes);
+    level_start = std::move(levels);
+    link_data = std::move(data);
+    n_nodes = n_points;
+    return true;
+}
+
+uint32_t HNSWIndex::greedyDescend(const FeatureMatrix& points, SquaredL2Fn distance,
+                                  const double* sample, uint32_t start, int from_level,
+                                  int to_level) const {
+    uint32_t current = start;
+    double current_dist = distance(sample, points.row(current), points.stride());
+
+    for (int level = from_level; level > to_level; --level) {
+        bool improved = true;
+        while (improved) {
+            improved = false;
+            const uint32_t* begin;
+            const uint32_t* end;
+            neighboursOf(current, level, begin, end);
+            for (const uint32_t* it = begin; it != end; ++it) {
+                uint32_t next = *it;
+                double d = distance(sample, points.row(next), points.stride());
+                if (d < current_dist || (d == current_dist && next < current)) {
+                    current = next;
+                    current_dist = d;
+                    improved = true;
+                }
+            }
+        }
+    }
+    return current;
+}
+
+void HNSWIndex::searchLayer(const FeatureMatrix& points, SquaredL2Fn distance,
+                            const double* sample, uint32_t start, size_t ef, int level,
+                            std::vector<Neighbour>& found) const {
+    VisitedSet& visited = threadVisited();
+    visited.reset(n_nodes);
+
+    // candidates - min-куча кандидатов на раскрытие, best - max-куча из ef лучших.
+    // Буферы свои у каждого потока и переиспользуются между запросами.
+    static thread_local std::vector<Neighbour> candidates;
+    static thread_local TopK best;
+    const auto closer_first = std::greater<Neighbour>();
+    candidates.clear();
+    best.reset(ef);
+
+    double d = distance(sample, points.row(start), points.stride());
+    visited.visit(start);
+    candidates.push_back({d, start});
+    best.push(d, start);
+
+    while (!candidates.empty()) {
+        Neighbour current = candidates.front();
+        if (best.full() && current.distance > best.bound()) break;
+        std::pop_heap(candidates.begin(), candidates.end(), closer_first);
+        candidates.pop_back();
+
+        const uint32_t* begin;
+        const uint32_t* end;
+        neighboursOf(static_cast<uint32_t>(current.index), level, begin, end);
+        for (const uint32_t* it = begin; it != end; ++it) {
+            uint32_t next = *it;
+            if (!visited.visit(next)) continue;
+            double nd = distance(sample, points.row(next), points.stride());
+            if (!best.full() || nd < best.bound()) {
+                candidates.push_back({nd, next});
+                std::push_heap(candidates.begin(), candidates.end(), closer_first);
+                best.push(nd, next);
+            }
+        }
+    }
+
+    best.sortedInto(found);
+}
+
+void HNSWIndex::selectNeighbours(const FeatureMatrix& points, SquaredL2Fn distance,
+                                 std::vector<Neighbour>& candidates, size_t m) const {
+    // Эвристика из статьи HNSW: кандидат берется, только если он ближе
+    // к новому узлу, чем к любому уже выбранному соседу. Так связи
+    // расходятся в разные стороны, а не собираются в одном кластере.
+    std::sort(candidates.begin(), candidates.end());
+    std::vector<Neighbour> selected;
+    std::vector<Neighbour> rejected;
+    for (const Neighbour& candidate : candidates) {
+        if (selected.size() >= m) break;
+        bool keep = true;
+        for (const Neighbour& chosen : selected) {
+            double between = distance(points.row(candidate.index), points.row(chosen.index),
+                                      points.stride());
+            if (between < candidate.distance) {
+                keep = false;
+                break;
+            }
+        }
+        (keep ? selected : rejected).push_back(candidate);
+    }
+    // Недобор заполняется ближайшими из отброшенных
+    for (size_t i = 0; i < rejected.size() && selected.size() < m; ++i) {
+        selected.push_back(rejected[i]);
+    }
+    candidates.swap(selected);
+}
+
+void HNSWIndex::insert(const FeatureMatrix& points, SquaredL2Fn distance,
+                       uint32_t node, int level) {
+    links[node].resize(level + 1);
+    if (max_level < 0) {
+        entry_point = node;
+        max_level = level;
+        return;
+    }
+
+    const double* sample = points.row(node);
+    uint32_t start = greedyDescend(points, distance, sample, entry_point, max_level, level);
+
+    std::vector<Neighbour> found;
+    for (int l = std::min(level, max_level); l >= 0; --l) {
+        searchLayer(points, distance, sample, start, params.ef_construction, l, found);
+        start = static_cast<uint32_t>(found.front().index);
+
+        selectNeighbours(points, distance, found, params.M);
+        for (const Neighbour& neighbour : found) {
+            uint32_t other = static_cast<uint32_t>(neighbour.index);
+            links[node][l].push_back(other);
+
+            // Обратная связь; переполненный список соседа прореживается
+            std::vector<uint32_t>& back = links[other][l];
+            back.push_back(node);
+            if (back.size() > maxLinks(l)) {
+                std::vector<Neighbour> pruned;
+                const double* base = points.row(other);
+                for (uint32_t id : back) {
+                    pruned.push_back({distance(base, points.row(id), points.stride()), id});
+                }
+                selectNeighbours(points, distance, pruned, maxLinks(l));
+                back.clear();
+                for (const Neighbour& kept : pruned) {
+                    back.push_back(static_cast<uint32_t>(kept.index));
+                }
+            }
+        }
+    }
+
+    if (level > max_level) {
+        max_level = level;
+        entry_point = node;
+    }
+}
+
+void HNSWIndex::build(const FeatureMatrix& points, SquaredL2Fn distance) {
+    n_nodes = points.rows();
+    links.assign(n_nodes, {});
+    entry_point = 0;
+    max_level = -1;
+
+    std::mt19937 gen(params.seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+    for (size_t i = 0; i < points.rows(); ++i) {
+        double u = std::max(uniform(gen), 1e-12);
+        int level = static_cast<int>(-std::log(u) * level_mult);
+        insert(points, distance, static_cast<uint32_t>(i), level);
+    }
+    flatten();
+}
+
+void HNSWIndex::query(const FeatureMatrix& points, SquaredL2Fn distance,
+                      const double* sample, size_t k, TopK& result) const {
+    result.reset(k);
+    if (max_level < 0 || k == 0) return;
+
+    uint32_t start = greedyDescend(points, distance, sample, entry_point, max_level, 0);
+
+    static thread_local std::vector<Neighbour> found;
+    searchLayer(points, distance, sample, start, std::max(params.ef_search, k), 0, found);
+    for (const Neighbour& neighbour : found) {
+        result.push(neighbour.distance, neighbour.index);
+    }
+}
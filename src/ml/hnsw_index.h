@@ -0,0 +1,77 @@
+#ifndef HNSW_INDEX_H
+#define HNSW_INDEX_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include "spatial_index.h"
+
+// Параметры графа HNSW
+struct HNSWParams {
+    size_t M = 16;                // число связей на узел (на слое 0 - 2*M)
+    size_t ef_construction = 200; // ширина поиска при построении
+    size_t ef_search = 64;        // ширина поиска при запросе (>= k)
+    uint32_t seed = 42;           // зерно для выбора уровней узлов
+};
+
+// Приближенный поиск соседей по иерархическому графу малого мира
+// (Hierarchical Navigable Small World). Находит соседей за время,
+// близкое к логарифмическому, ценой небольшой потери полноты (recall),
+// которая регулируется ef_search.
+class HNSWIndex : public NeighbourIndex {
+private:
+    // Заголовок графа; хранится в файле модели как есть
+    struct GraphHeader {
+        uint64_t M;
+        uint64_t ef_construction;
+        uint64_t ef_search;
+        uint32_t entry_point;
+        int32_t max_level;
+    };
+
+    HNSWParams params;
+    double level_mult;
+    uint32_t entry_point;
+    int max_level;
+    size_t n_nodes;
+    // Во время построения: links[node][level] - соседи узла на уровне
+    std::vector<std::vector<std::vector<uint32_t>>> links;
+    // После построения - плоское представление: соседи узла node на уровне l
+    // лежат в link_data[level_start[node_start[node] + l] .. level_start[... + l + 1])
+    AlignedBuffer<uint32_t> node_start;
+    AlignedBuffer<uint32_t> level_start;
+    AlignedBuffer<uint32_t> link_data;
+    GraphHeader header;  // заполняется для exportBlobs
+
+    size_t maxLinks(int level) const { return level == 0 ? 2 * params.M : params.M; }
+    void neighboursOf(uint32_t node, int level, const uint32_t*& begin,
+                      const uint32_t*& end) const;
+    void flatten();
+
+    uint32_t greedyDescend(const FeatureMatrix& points, SquaredL2Fn distance,
+                           const double* sample, uint32_t start, int from_level,
+                           int to_level) const;
+    void searchLayer(const FeatureMatrix& points, SquaredL2Fn distance,
+                     const double* sample, uint32_t start, size_t ef, int level,
+                     std::vector<Neighbour>& found) const;
+    void selectNeighbours(const FeatureMatrix& points, SquaredL2Fn distance,
+                          std::vector<Neighbour>& candidates, size_t m) const;
+    void insert(const FeatureMatrix& points, SquaredL2Fn distance,
+                uint32_t node, int level);
+
+public:
+    explicit HNSWIndex(const HNSWParams& params = HNSWParams());
+    void build(const FeatureMatrix& points, SquaredL2Fn distance) override;
+    void query(const FeatureMatrix& points, SquaredL2Fn distance,
+               const double* sample, size_t k, TopK& result) const override;
+    const char* name() const override { return "hnsw"; }
+    std::vector<Blob> exportBlobs() const override;
+    bool importBlobs(const std::vector<Blob>& blobs, std::shared_ptr<const void> owner,
+                     const FeatureMatrix& points) override;
+
+    // ef_search можно менять без перестроения графа
+    void setEfSearch(size_t ef) { params.ef_search = header.ef_search = ef; }
+    const HNSWParams& parameters() const { return params; }
+};
+
+#endif
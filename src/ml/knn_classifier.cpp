@@ -1,109 +1,795 @@
 #include "knn_classifier.h"
 #include <iostream>
 #include <unordered_map>
+#include <limits>
+#include <cfloat>
+#include <mutex>
 
-KNNClassifier::KNNClassifier() : n_features(0) {}
+namespace {
 
-double KNNClassifier::calculateDistance(const std::vector<double>& a, 
-                                      const std::vector<double>& b) {
-    double sum = 0.0;
-    for (size_t i = 0; i < a.size(); ++i) {
-        double diff = a[i] - b[i];
-        sum += diff * diff;
+// Размеры блоков пакетного пути: блок запросов кратен 4, блок строк кратен 8
+// (требования микроядра dotBlock); произведения блока помещаются в L2
+const size_t QUERY_BLOCK = 32;
+const size_t ROW_TILE = 512;
+
+uint8_t quantize(double value, double min_value, double step) {
+    double code = std::round((value - min_value) / step);
+    return static_cast<uint8_t>(std::min(255.0, std::max(0.0, code)));
+}
+
+} // namespace
+
+struct KNNClassifier::QueryScratch {
+    AlignedBuffer<double> query;
+    std::vector<double> distances;
+    TopK heap;
+    std::vector<Neighbour> neighbours;
+    std::vector<int> votes;
+    std::vector<size_t> first_rank;
+
+    // Запрос в формате пониженной точности
+    AlignedBuffer<float> query_f32;
+    AlignedBuffer<uint8_t> query_u8;
+
+    // Буферы пакетного пути
+    AlignedBuffer<double> block_queries;
+    AlignedBuffer<double> block_products;
+    std::vector<double> block_norms;
+    std::vector<TopK> block_heaps;
+    std::vector<std::vector<Neighbour>> block_candidates;
+};
+
+KNNClassifier::QueryScratch& KNNClassifier::threadScratch() {
+    static thread_local QueryScratch scratch;
+    return scratch;
+}
+
+KNNClassifier::KNNClassifier()
+    : precision(Precision::Float64), stored_precision(Precision::Float64),
+      quant_min(0.0), quant_step(1.0),
+      n_features(0), scan_layout(ScanLayout::RowMajor), kernels(&distanceKernels()),
+      index_type(IndexType::Auto), num_threads(0), batch_threshold(64) {}
+
+double KNNClassifier::squaredDistance(const double* a, const double* b) const {
+    // Строки дополнены нулями до stride, поэтому ядро работает целыми регистрами
+    return kernels->squaredL2(a, b, training_matrix.stride());
+}
+
+void KNNClassifier::computeDistances(const double* query,
+                                     std::vector<double>& distances) const {
+    size_t n_rows = training_matrix.rows();
+    distances.resize(n_rows);
+
+    if (scan_layout == ScanLayout::ColumnMajor && training_matrix.hasColumnMajor()) {
+        // Накопление по столбцам: внутренний цикл идет по непрерывным строкам
+        std::fill(distances.begin(), distances.end(), 0.0);
+        for (int j = 0; j < n_features; ++j) {
+            const double* column = training_matrix.column(j);
+            double q = query[j];
+            for (size_t i = 0; i < n_rows; ++i) {
+                double diff = column[i] - q;
+                distances[i] += diff * diff;
+            }
+        }
+        return;
+    }
+
+    for (size_t i = 0; i < n_rows; ++i) {
+        distances[i] = squaredDistance(query, training_matrix.row(i));
+    }
+}
+
+void KNNClassifier::computeReducedDistances(const double* sample, size_t length,
+                                            QueryScratch& scratch) const {
+    size_t n = std::min<size_t>(length, n_features);
+
+    if (stored_precision == Precision::Float32) {
+        size_t stride = training_f32.stride();
+        if (scratch.query_f32.size() < stride) {
+            scratch.query_f32 = AlignedBuffer<float>(stride);
+        }
+        std::fill_n(scratch.query_f32.data(), scratch.query_f32.size(), 0.0f);
+        for (size_t j = 0; j < n; ++j) {
+            scratch.query_f32[j] = static_cast<float>(sample[j]);
+        }
+        scratch.distances.resize(training_f32.rows());
+        for (size_t i = 0; i < training_f32.rows(); ++i) {
+            scratch.distances[i] = kernels->squaredL2F32(scratch.query_f32.data(),
+                                                         training_f32.row(i), stride);
+        }
+        return;
+    }
+
+    size_t stride = training_u8.stride();
+    if (scratch.query_u8.size() < stride) {
+        scratch.query_u8 = AlignedBuffer<uint8_t>(stride);
+    }
+    std::fill_n(scratch.query_u8.data(), scratch.query_u8.size(), 0);
+    for (size_t j = 0; j < n; ++j) {
+        scratch.query_u8[j] = quantize(sample[j], quant_min, quant_step);
     }
-    return std::sqrt(sum);
+    double scale = quant_step * quant_step;
+    scratch.distances.resize(training_u8.rows());
+    for (size_t i = 0; i < training_u8.rows(); ++i) {
+        scratch.distances[i] = scale * kernels->squaredL2U8(scratch.query_u8.data(),
+                                                            training_u8.row(i), stride);
+    }
+}
+
+void KNNClassifier::setNormalization(const DataProcessor::NormalizationParams& params) {
+    normalization_params = params;
 }
 
-void KNNClassifier::fit(const std::vector<std::vector<double>>& data, 
+void KNNClassifier::setPrecision(Precision p) {
+    precision = p;
+}
+
+size_t KNNClassifier::memoryFootprint() const {
+    size_t bytes = training_matrix.rows() * training_matrix.stride() * sizeof(double);
+    if (training_matrix.hasColumnMajor()) {
+        bytes += training_matrix.cols() * training_matrix.columnStride() * sizeof(double);
+    }
+    bytes += training_f32.rows() * training_f32.stride() * sizeof(float);
+    bytes += training_u8.rows() * training_u8.stride() * sizeof(uint8_t);
+    bytes += training_norms.size() * sizeof(double);
+    bytes += training_class_ids.size() * sizeof(int32_t);
+    return bytes;
+}
+
+void KNNClassifier::fit(const std::vector<std::vector<double>>& data,
                        const std::vector<std::string>& labels) {
-    training_data = data;
-    training_labels = labels;
-    if (!data.empty()) {
-        n_features = data[0].size();
+    training_matrix = FeatureMatrix::fromRows(data);
+
+    // Кодирование меток целыми номерами в порядке первого появления
+    class_names.clear();
+    class_index.clear();
+    training_class_ids = AlignedBuffer<int32_t>(labels.size());
+    for (size_t i = 0; i < labels.size(); ++i) {
+        auto it = class_index.find(labels[i]);
+        if (it == class_index.end()) {
+            int id = static_cast<int>(class_names.size());
+            it = class_index.emplace(labels[i], id).first;
+            class_names.push_back(labels[i]);
+        }
+        training_class_ids[i] = it->second;
     }
+
+    prepareTraining();
 }
 
-std::string KNNClassifier::predict(const std::vector<double>& sample, int k) {
-    std::vector<DistanceLabel> distances;
-    
-    for (size_t i = 0; i < training_data.size(); ++i) {
-        double dist = calculateDistance(sample, training_data[i]);
-        distances.push_back({dist, training_labels[i]});
-    }
-    
-    std::sort(distances.begin(), distances.end());
-    
-    std::unordered_map<std::string, int> label_count;
-    for (int i = 0; i < k && i < static_cast<int>(distances.size()); ++i) {
-        label_count[distances[i].label]++;
-    }
-    
-    std::string best_label;
+void KNNClassifier::fit(const DataProcessor::NetworkTrafficData& data) {
+    // Номера классов берутся из label_ids и label_encoding; допустимы только
+    // плотные номера 0..n-1, иначе метки кодируются заново по строкам
+    size_t n_rows = data.features.size();
+    size_t n_codes = data.label_encoding.size();
+    auto refit = [this, &data, n_rows]() {
+        if (data.labels.size() != n_rows) {
+            std::cerr << "Error: " << data.labels.size() << " labels for "
+                      << n_rows << " training rows" << std::endl;
+            return;
+        }
+        fit(data.features, data.labels);
+    };
+
+    std::vector<std::string> names(n_codes);
+    std::unordered_map<std::string, int> codes;
+    for (const auto& entry : data.label_encoding) {
+        if (entry.second < 0 || static_cast<size_t>(entry.second) >= n_codes ||
+            !names[entry.second].empty()) {
+            refit();
+            return;
+        }
+        names[entry.second] = entry.first;
+        codes.emplace(entry.first, entry.second);
+    }
+
+    // Номера проверяются до изменения модели: номер вне [0, n_codes) или
+    // метка без кода означают, что label_ids не согласованы со словарем
+    AlignedBuffer<int32_t> ids(n_rows);
+    bool have_ids = data.label_ids.size() == n_rows;
+    if (!have_ids && data.labels.size() != n_rows) {
+        refit();
+        return;
+    }
+    for (size_t i = 0; i < n_rows; ++i) {
+        int32_t id = -1;
+        if (have_ids) {
+            id = data.label_ids[i];
+        } else {
+            auto it = codes.find(data.labels[i]);
+            if (it != codes.end()) id = it->second;
+        }
+        if (id < 0 || static_cast<size_t>(id) >= n_codes) {
+            refit();
+            return;
+        }
+        ids[i] = id;
+    }
+
+    training_matrix = FeatureMatrix::fromRows(data.features);
+    class_names = std::move(names);
+    class_index.clear();
+    for (size_t c = 0; c < class_names.size(); ++c) {
+        class_index.emplace(class_names[c], static_cast<int>(c));
+    }
+    training_class_ids = std::move(ids);
+
+    prepareTraining();
+}
+
+void KNNClassifier::fit(const DataProcessor::DatasetView& data) {
+    const DataProcessor::FeatureTable& table = *data.table;
+    training_matrix = FeatureMatrix(data.size(), table.features.cols());
+    for (size_t i = 0; i < data.size(); ++i) {
+        std::copy_n(data.features(i), table.features.cols(), training_matrix.row(i));
+    }
+
+    // Номера классов - в порядке первого появления среди строк представления
+    class_names.clear();
+    class_index.clear();
+    std::vector<int> class_of_label(table.label_names.size(), -1);
+    training_class_ids = AlignedBuffer<int32_t>(data.size());
+    for (size_t i = 0; i < data.size(); ++i) {
+        int32_t label = data.labelId(i);
+        if (class_of_label[label] < 0) {
+            class_of_label[label] = static_cast<int>(class_names.size());
+            class_index.emplace(table.label_names[label], class_of_label[label]);
+            class_names.push_back(table.label_names[label]);
+        }
+        training_class_ids[i] = class_of_label[label];
+    }
+
+    prepareTraining();
+}
+
+void KNNClassifier::prepareTraining() {
+    n_features = static_cast<int>(training_matrix.cols());
+    stored_precision = precision;
+
+    training_f32 = AlignedMatrix<float>();
+    training_u8 = AlignedMatrix<uint8_t>();
+    training_norms = AlignedBuffer<double>();
+
+    if (stored_precision == Precision::Float32) {
+        training_f32 = AlignedMatrix<float>(training_matrix.rows(), training_matrix.cols());
+        for (size_t i = 0; i < training_matrix.rows(); ++i) {
+            const double* src = training_matrix.row(i);
+            float* dst = training_f32.row(i);
+            for (int j = 0; j < n_features; ++j) {
+                dst[j] = static_cast<float>(src[j]);
+            }
+        }
+    } else if (stored_precision == Precision::UInt8) {
+        // Общий для всех признаков диапазон: целое расстояние между кодами
+        // пропорционально настоящему, масштаб - quant_step^2
+        double lo = std::numeric_limits<double>::max();
+        double hi = std::numeric_limits<double>::lowest();
+        for (size_t i = 0; i < training_matrix.rows(); ++i) {
+            const double* row = training_matrix.row(i);
+            for (int j = 0; j < n_features; ++j) {
+                lo = std::min(lo, row[j]);
+                hi = std::max(hi, row[j]);
+            }
+        }
+        quant_min = training_matrix.empty() ? 0.0 : lo;
+        quant_step = (hi > lo) ? (hi - lo) / 255.0 : 1.0;
+
+        training_u8 = AlignedMatrix<uint8_t>(training_matrix.rows(), training_matrix.cols());
+        for (size_t i = 0; i < training_matrix.rows(); ++i) {
+            const double* src = training_matrix.row(i);
+            uint8_t* dst = training_u8.row(i);
+            for (int j = 0; j < n_features; ++j) {
+                dst[j] = quantize(src[j], quant_min, quant_step);
+            }
+        }
+    }
+
+    if (stored_precision != Precision::Float64) {
+        // Матрица double больше не нужна: сокращение памяти - цель режима
+        training_matrix = FeatureMatrix();
+        index.reset();
+        return;
+    }
+
+    training_norms = AlignedBuffer<double>(training_matrix.rows());
+    for (size_t i = 0; i < training_matrix.rows(); ++i) {
+        const double* row = training_matrix.row(i);
+        double norm = 0.0;
+        for (int j = 0; j < n_features; ++j) {
+            norm += row[j] * row[j];
+        }
+        training_norms[i] = norm;
+    }
+
+    training_matrix.dropColumnMajor();
+    buildIndex();
+    updateColumnMajor();
+}
+
+void KNNClassifier::updateColumnMajor() {
+    // Column-major копия нужна для обхода по столбцам и для пакетного пути
+    bool needed = scan_layout == ScanLayout::ColumnMajor || (batch_threshold > 0 && !index);
+    if (needed && !training_matrix.empty() && !training_matrix.hasColumnMajor()) {
+        training_matrix.buildColumnMajor();
+    } else if (!needed) {
+        training_matrix.dropColumnMajor();
+    }
+}
+
+void KNNClassifier::buildIndex() {
+    index.reset();
+    if (stored_precision != Precision::Float64) return;
+
+    IndexType type = index_type;
+    if (type == IndexType::Auto) {
+        // На малых выборках перебор быстрее обхода дерева. KD-дерево
+        // эффективно при малой размерности, VP-дерево - при большой.
+        if (training_matrix.rows() < 4096) {
+            type = IndexType::BruteForce;
+        } else if (n_features <= 16) {
+            type = IndexType::KDTree;
+        } else {
+            type = IndexType::VPTree;
+        }
+    }
+
+    if (type == IndexType::KDTree) {
+        index = std::make_shared<KDTree>();
+    } else if (type == IndexType::VPTree) {
+        index = std::make_shared<VPTree>();
+    } else if (type == IndexType::HNSW) {
+        index = std::make_shared<HNSWIndex>(hnsw_params);
+    }
+    if (index && !training_matrix.empty()) {
+        index->build(training_matrix, kernels->squaredL2);
+    }
+}
+
+void KNNClassifier::setIndexType(IndexType type) {
+    index_type = type;
+    if (!training_class_ids.empty()) {
+        buildIndex();
+        updateColumnMajor();
+    }
+}
+
+void KNNClassifier::setHNSWParams(const HNSWParams& params) {
+    hnsw_params = params;
+    if (index_type == IndexType::HNSW && !training_class_ids.empty()) {
+        buildIndex();
+        updateColumnMajor();
+    }
+}
+
+void KNNClassifier::setEfSearch(size_t ef) {
+    hnsw_params.ef_search = ef;
+    if (auto* hnsw = dynamic_cast<HNSWIndex*>(index.get())) {
+        hnsw->setEfSearch(ef);
+    }
+}
+
+void KNNClassifier::setScanLayout(ScanLayout layout) {
+    scan_layout = layout;
+    updateColumnMajor();
+}
+
+void KNNClassifier::setBatchThreshold(size_t n) {
+    batch_threshold = n;
+    updateColumnMajor();
+}
+
+void KNNClassifier::setSimdLevel(SimdLevel level) {
+    kernels = &distanceKernelsFor(level);
+}
+
+void KNNClassifier::setNumThreads(size_t n) {
+    num_threads = n;
+    own_pool.reset();
+    if (n > 1) {
+        own_pool = std::make_shared<ThreadPool>(n);
+    }
+}
+
+ThreadPool* KNNClassifier::pool() {
+    if (num_threads == 1) return nullptr;
+    if (own_pool) return own_pool.get();
+    return &ThreadPool::shared();
+}
+
+void KNNClassifier::findNearest(const double* sample, size_t length, size_t k,
+                                QueryScratch& scratch) const {
+    if (training_matrix.empty()) {
+        computeReducedDistances(sample, length, scratch);
+        selectNearest(scratch.distances, k, scratch.heap, scratch.neighbours);
+        return;
+    }
+
+    // Запрос копируется в выровненный буфер с нулевым хвостом
+    if (scratch.query.size() < training_matrix.stride()) {
+        scratch.query = AlignedBuffer<double>(training_matrix.stride());
+    }
+    std::fill_n(scratch.query.data(), scratch.query.size(), 0.0);
+    std::copy_n(sample, std::min<size_t>(length, n_features), scratch.query.data());
+
+    if (index) {
+        index->query(training_matrix, kernels->squaredL2, scratch.query.data(), k, scratch.heap);
+        scratch.heap.sortedInto(scratch.neighbours);
+    } else {
+        computeDistances(scratch.query.data(), scratch.distances);
+        selectNearest(scratch.distances, k, scratch.heap, scratch.neighbours);
+    }
+}
+
+int KNNClassifier::predictClassId(const double* sample, size_t length, int k) const {
+    if (training_class_ids.empty()) return -1;
+
+    QueryScratch& scratch = threadScratch();
+    findNearest(sample, length, static_cast<size_t>(std::max(k, 0)), scratch);
+    return voteClassId(scratch.neighbours, scratch);
+}
+
+std::vector<Neighbour> KNNClassifier::findNeighbours(const std::vector<double>& sample,
+                                                     int k) const {
+    std::vector<Neighbour> neighbours;
+    findNeighbours(sample.data(), sample.size(), k, neighbours);
+    return neighbours;
+}
+
+void KNNClassifier::findNeighbours(const double* sample, size_t length, int k,
+                                   std::vector<Neighbour>& out) const {
+    out.clear();
+    if (training_class_ids.empty()) return;
+
+    QueryScratch& scratch = threadScratch();
+    findNearest(sample, length, static_cast<size_t>(std::max(k, 0)), scratch);
+    out.assign(scratch.neighbours.begin(), scratch.neighbours.end());
+}
+
+int KNNClassifier::voteClassId(const std::vector<Neighbour>& neighbours,
+                               QueryScratch& scratch) const {
+    // Голосование по номерам классов. При равенстве голосов побеждает класс,
+    // чей представитель встретился раньше в отсортированном списке соседей.
+    std::vector<int>& votes = scratch.votes;
+    std::vector<size_t>& first_rank = scratch.first_rank;
+    votes.assign(class_names.size(), 0);
+    first_rank.assign(class_names.size(), neighbours.size());
+    for (size_t i = 0; i < neighbours.size(); ++i) {
+        int class_id = training_class_ids[neighbours[i].index];
+        if (votes[class_id]++ == 0) {
+            first_rank[class_id] = i;
+        }
+    }
+
+    int best_class = -1;
     int max_count = 0;
-    for (const auto& pair : label_count) {
-        if (pair.second > max_count) {
-            max_count = pair.second;
-            best_label = pair.first;
+    for (size_t c = 0; c < votes.size(); ++c) {
+        if (votes[c] > max_count ||
+            (votes[c] == max_count && max_count > 0 && first_rank[c] < first_rank[best_class])) {
+            max_count = votes[c];
+            best_class = static_cast<int>(c);
+        }
+    }
+
+    return best_class;
+}
+
+void KNNClassifier::rerankCandidates(const double* query, std::vector<Neighbour>& candidates,
+                                     size_t k, QueryScratch& scratch) const {
+    // Расстояния считаются так же, как в computeDistances, поэтому соседи
+    // и разрешение равенств совпадают с поштучным предсказанием
+    if (scan_layout == ScanLayout::ColumnMajor) {
+        for (auto& candidate : candidates) candidate.distance = 0.0;
+        for (int j = 0; j < n_features; ++j) {
+            const double* column = training_matrix.column(j);
+            double q = query[j];
+            for (auto& candidate : candidates) {
+                double diff = column[candidate.index] - q;
+                candidate.distance += diff * diff;
+            }
+        }
+    } else {
+        for (auto& candidate : candidates) {
+            candidate.distance = squaredDistance(query, training_matrix.row(candidate.index));
+        }
+    }
+
+    scratch.heap.reset(k);
+    for (const auto& candidate : candidates) {
+        scratch.heap.push(candidate.distance, candidate.index);
+    }
+    scratch.heap.sortedInto(scratch.neighbours);
+}
+
+void KNNClassifier::predictBlockGemm(const SampleRows& samples,
+                                     size_t begin, size_t end, int k,
+                                     std::vector<int>& class_ids) const {
+    QueryScratch& scratch = threadScratch();
+    size_t stride = training_matrix.stride();
+    size_t n_rows = training_matrix.rows();
+    size_t n_neighbours = static_cast<size_t>(std::max(k, 0));
+
+    if (scratch.block_queries.size() < QUERY_BLOCK * stride) {
+        scratch.block_queries = AlignedBuffer<double>(QUERY_BLOCK * stride);
+    }
+    if (scratch.block_products.empty()) {
+        scratch.block_products = AlignedBuffer<double>(QUERY_BLOCK * ROW_TILE);
+    }
+    scratch.block_norms.resize(QUERY_BLOCK);
+    scratch.block_heaps.resize(QUERY_BLOCK);
+    scratch.block_candidates.resize(QUERY_BLOCK);
+
+    if (n_neighbours == 0) {
+        std::fill(class_ids.begin() + begin, class_ids.begin() + end, -1);
+        return;
+    }
+
+    // Оценка погрешности ||q||^2 + ||x||^2 - 2 q.x относительно точного ядра:
+    // O(n_features * eps * (||q||^2 + ||x||^2)). Все строки, которые могут
+    // оказаться среди k ближайших по точному ядру, лежат в пределах двух
+    // таких погрешностей от k-го блочного расстояния.
+    double max_norm = 0.0;
+    for (size_t r = 0; r < n_rows; ++r) {
+        max_norm = std::max(max_norm, training_norms[r]);
+    }
+    double error_scale = 16.0 * (n_features + 2) * DBL_EPSILON;
+
+    for (size_t first = begin; first < end; first += QUERY_BLOCK) {
+        size_t nq = std::min(QUERY_BLOCK, end - first);
+        size_t nq_padded = (nq + 3) / 4 * 4;
+
+        // Упаковка блока запросов; недостающие строки остаются нулевыми
+        std::fill_n(scratch.block_queries.data(), nq_padded * stride, 0.0);
+        for (size_t i = 0; i < nq; ++i) {
+            double* dst = scratch.block_queries.data() + i * stride;
+            size_t n = std::min<size_t>(samples.length(first + i), n_features);
+            std::copy_n(samples.data(first + i), n, dst);
+            double norm = 0.0;
+            for (size_t j = 0; j < n; ++j) {
+                norm += dst[j] * dst[j];
+            }
+            scratch.block_norms[i] = norm;
+            scratch.block_heaps[i].reset(n_neighbours);
+            scratch.block_candidates[i].clear();
+        }
+
+        // Проход по обучающей выборке плитками ROW_TILE строк
+        for (size_t tile = 0; tile < n_rows; tile += ROW_TILE) {
+            size_t nr = std::min(ROW_TILE, n_rows - tile);
+            size_t nr_padded = (nr + 7) / 8 * 8;
+            kernels->dotBlock(scratch.block_queries.data(), stride, nq_padded,
+                              training_matrix.column(0) + tile, training_matrix.columnStride(),
+                              nr_padded, n_features, scratch.block_products.data(), ROW_TILE);
+
+            for (size_t i = 0; i < nq; ++i) {
+                const double* products = scratch.block_products.data() + i * ROW_TILE;
+                TopK& heap = scratch.block_heaps[i];
+                std::vector<Neighbour>& candidates = scratch.block_candidates[i];
+                double query_norm = scratch.block_norms[i];
+                double tolerance = error_scale * (query_norm + max_norm);
+                double bound = heap.bound();
+                for (size_t r = 0; r < nr; ++r) {
+                    double d = query_norm + training_norms[tile + r] - 2.0 * products[r];
+                    if (d < 0.0) d = 0.0;  // погрешность округления
+                    if (d <= bound + tolerance) {
+                        candidates.push_back({d, tile + r});
+                        if (d <= bound) {
+                            heap.push(d, tile + r);
+                            bound = heap.bound();
+                        }
+                    }
+                }
+                // Кандидаты, отставшие от текущей границы, больше не нужны
+                double limit = bound + tolerance;
+                candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+                                                [limit](const Neighbour& c) {
+                                                    return c.distance > limit;
+                                                }),
+                                 candidates.end());
+            }
+        }
+
+        // Окончательный отбор k ближайших точным ядром
+        for (size_t i = 0; i < nq; ++i) {
+            rerankCandidates(scratch.block_queries.data() + i * stride,
+                             scratch.block_candidates[i], n_neighbours, scratch);
+            class_ids[first + i] = voteClassId(scratch.neighbours, scratch);
+        }
+    }
+}
+
+void KNNClassifier::runBatch(const SampleRows& samples, int k,
+                             const std::function<void(size_t, size_t, const std::vector<int>&)>& consume,
+                             std::vector<int>& class_ids) {
+    class_ids.assign(samples.count, -1);
+    if (training_class_ids.empty()) {
+        consume(0, samples.count, class_ids);
+        return;
+    }
+
+    // Большие пакеты при полном переборе считаются блочно через скалярные
+    // произведения, как умножение матриц
+    bool use_gemm = !index && batch_threshold > 0 && samples.count >= batch_threshold &&
+                    training_matrix.hasColumnMajor();
+
+    auto body = [&](size_t begin, size_t end) {
+        if (use_gemm) {
+            predictBlockGemm(samples, begin, end, k, class_ids);
+        } else {
+            for (size_t i = begin; i < end; ++i) {
+                class_ids[i] = predictClassId(samples.data(i), samples.length(i), k);
+            }
+        }
+        consume(begin, end, class_ids);
+    };
+
+    ThreadPool* workers = pool();
+    if (workers == nullptr || samples.count < 2) {
+        body(0, samples.count);
+    } else {
+        // Несколько отрезков на поток, чтобы перехват выравнивал нагрузку
+        size_t grain = std::max<size_t>(1, samples.count / ((workers->size() + 1) * 8));
+        if (use_gemm) {
+            grain = (grain + QUERY_BLOCK - 1) / QUERY_BLOCK * QUERY_BLOCK;
+        }
+        workers->parallelFor(0, samples.count, grain, body);
+    }
+}
+
+std::vector<int> KNNClassifier::predictClassIds(const SampleRows& samples, int k) {
+    std::vector<int> class_ids;
+    runBatch(samples, k, [](size_t, size_t, const std::vector<int>&) {}, class_ids);
+    return class_ids;
+}
+
+ConfusionMatrix KNNClassifier::emptyConfusion() const {
+    // В усреднение входят только классы, представленные в обучающей выборке
+    ConfusionMatrix matrix(class_names.size());
+    std::vector<char> trained(class_names.size(), 0);
+    for (size_t i = 0; i < training_class_ids.size(); ++i) {
+        trained[training_class_ids[i]] = 1;
+    }
+    for (size_t c = 0; c < class_names.size(); ++c) {
+        matrix.setActive(c, trained[c] != 0);
+    }
+    return matrix;
+}
+
+void KNNClassifier::evaluateRows(const SampleRows& samples, const int32_t* actual, int k,
+                                 ConfusionMatrix& total) {
+    // Каждый отрезок считает свою матрицу сразу после предсказания;
+    // матрицы отрезков складываются в общую
+    std::mutex merge_mutex;
+    std::vector<int> class_ids;
+    runBatch(samples, k, [&](size_t begin, size_t end, const std::vector<int>& predicted) {
+        ConfusionMatrix local(class_names.size());
+        for (size_t i = begin; i < end; ++i) {
+            local.add(actual[i], predicted[i]);
         }
+        std::lock_guard<std::mutex> lock(merge_mutex);
+        total.merge(local);
+    }, class_ids);
+}
+
+std::vector<int32_t> KNNClassifier::encodeLabels(const std::vector<std::string>& labels) const {
+    std::vector<int32_t> ids(labels.size(), -1);
+    for (size_t i = 0; i < labels.size(); ++i) {
+        auto it = class_index.find(labels[i]);
+        if (it != class_index.end()) ids[i] = it->second;
     }
-    
-    return best_label;
+    return ids;
+}
+
+std::vector<int> KNNClassifier::predictClassIds(const FeatureMatrix& samples, int k) {
+    return predictClassIds(SampleRows{nullptr, &samples, samples.rows()}, k);
+}
+
+std::vector<int> KNNClassifier::predictClassIds(const DataProcessor::DatasetView& samples, int k) {
+    return predictClassIds(SampleRows{nullptr, &samples.table->features, samples.size(),
+                                      samples.rows.data()}, k);
+}
+
+std::string KNNClassifier::predict(const std::vector<double>& sample, int k) {
+    int class_id = predictClassId(sample.data(), sample.size(), k);
+    return class_id >= 0 ? class_names[class_id] : std::string();
 }
 
 std::vector<std::string> KNNClassifier::predictBatch(
     const std::vector<std::vector<double>>& samples, int k) {
+    auto class_ids = predictClassIds(SampleRows{samples.data(), nullptr, samples.size()}, k);
+    std::vector<std::string> predictions;
+    predictions.reserve(samples.size());
+    for (int class_id : class_ids) {
+        predictions.push_back(class_id >= 0 ? class_names[class_id] : std::string());
+    }
+    return predictions;
+}
+
+std::vector<std::string> KNNClassifier::predictBatch(const FeatureMatrix& samples, int k) {
+    auto class_ids = predictClassIds(samples, k);
     std::vector<std::string> predictions;
-    for (const auto& sample : samples) {
-        predictions.push_back(predict(sample, k));
+    predictions.reserve(class_ids.size());
+    for (int class_id : class_ids) {
+        predictions.push_back(class_id >= 0 ? class_names[class_id] : std::string());
     }
     return predictions;
 }
 
+ConfusionMatrix KNNClassifier::evaluate(const std::vector<std::vector<double>>& test_data,
+                                        const std::vector<int32_t>& test_class_ids, int k) {
+    ConfusionMatrix total = emptyConfusion();
+    evaluateRows(SampleRows{test_data.data(), nullptr, test_data.size()},
+                 test_class_ids.data(), k, total);
+    return total;
+}
+
+ConfusionMatrix KNNClassifier::evaluate(const DataProcessor::NetworkTrafficData& test_data, int k) {
+    // Номер из label_encoding -> номер класса модели: строки сравниваются
+    // один раз на метку, а не на каждую строку
+    int max_code = -1;
+    for (const auto& entry : test_data.label_encoding) max_code = std::max(max_code, entry.second);
+    std::vector<int32_t> class_of_code(max_code + 1, -1);
+    for (const auto& entry : test_data.label_encoding) {
+        auto it = class_index.find(entry.first);
+        if (it != class_index.end()) class_of_code[entry.second] = it->second;
+    }
+
+    std::vector<int32_t> actual;
+    if (test_data.label_ids.size() == test_data.features.size()) {
+        actual.resize(test_data.label_ids.size());
+        for (size_t i = 0; i < actual.size(); ++i) {
+            int32_t code = test_data.label_ids[i];
+            actual[i] = code >= 0 && code <= max_code ? class_of_code[code] : -1;
+        }
+    } else {
+        actual = encodeLabels(test_data.labels);
+    }
+    return evaluate(test_data.features, actual, k);
+}
+
+ConfusionMatrix KNNClassifier::evaluate(const DataProcessor::DatasetView& test_data, int k) {
+    // Номер метки таблицы -> номер класса модели (-1, если класса нет)
+    const std::vector<std::string>& label_names = test_data.table->label_names;
+    std::vector<int32_t> class_of_label(label_names.size(), -1);
+    for (size_t label = 0; label < label_names.size(); ++label) {
+        auto it = class_index.find(label_names[label]);
+        if (it != class_index.end()) class_of_label[label] = it->second;
+    }
+
+    std::vector<int32_t> actual(test_data.size());
+    for (size_t i = 0; i < actual.size(); ++i) {
+        actual[i] = class_of_label[test_data.labelId(i)];
+    }
+    ConfusionMatrix total = emptyConfusion();
+    evaluateRows(SampleRows{nullptr, &test_data.table->features, test_data.size(),
+                            test_data.rows.data()}, actual.data(), k, total);
+    return total;
+}
+
+ConfusionMatrix KNNClassifier::evaluate(CSVBatchReader& reader, int k) {
+    // Словарь меток читателя начинается с классов модели, поэтому номера
+    // меток совпадают с номерами классов; новые метки получают номера дальше
+    // и в матрице считаются неизвестными
+    reader.setLabelNames(class_names);
+
+    ConfusionMatrix total = emptyConfusion();
+    DataProcessor::FeatureTable batch;
+    while (reader.next(batch)) {
+        evaluateRows(SampleRows{nullptr, &batch.features, batch.features.rows()},
+                     batch.label_ids.data(), k, total);
+    }
+    return total;
+}
+
 double KNNClassifier::calculateF1Score(const std::vector<std::vector<double>>& test_data,
                                      const std::vector<std::string>& test_labels,
                                      int k) {
-    auto predictions = predictBatch(test_data, k);
-    
-    std::unordered_map<std::string, int> true_positives;
-    std::unordered_map<std::string, int> false_positives;
-    std::unordered_map<std::string, int> false_negatives;
-    
-    std::unordered_map<std::string, bool> unique_labels;
-    for (const auto& label : training_labels) {
-        unique_labels[label] = true;
-    }
-    
-    for (size_t i = 0; i < predictions.size(); ++i) {
-        const std::string& predicted = predictions[i];
-        const std::string& actual = test_labels[i];
-        
-        if (predicted == actual) {
-            true_positives[actual]++;
-        } else {
-            false_positives[predicted]++;
-            false_negatives[actual]++;
-        }
-    }
-    
-    double macro_f1 = 0.0;
-    int label_count = 0;
-    
-    for (const auto& label_pair : unique_labels) {
-        const std::string& label = label_pair.first;
-        
-        int tp = true_positives[label];
-        int fp = false_positives[label];
-        int fn = false_negatives[label];
-        
-        double precision = (tp + fp > 0) ? static_cast<double>(tp) / (tp + fp) : 0.0;
-        double recall = (tp + fn > 0) ? static_cast<double>(tp) / (tp + fn) : 0.0;
-        
-        double f1 = (precision + recall > 0) ? 
-                   2 * precision * recall / (precision + recall) : 0.0;
-        
-        macro_f1 += f1;
-        label_count++;
-    }
-    
-    return (label_count > 0) ? macro_f1 / label_count : 0.0;
-}
\ No newline at end of file
+    return evaluate(test_data, encodeLabels(test_labels), k).macroF1();
+}
+
+double KNNClassifier::calculateF1Score(const DataProcessor::DatasetView& test_data, int k) {
+    return evaluate(test_data, k).macroF1();
+}
+
+double KNNClassifier::calculateF1Score(CSVBatchReader& reader, int k) {
+    return evaluate(reader, k).macroF1();
+}
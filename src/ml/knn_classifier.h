@@ -4,36 +4,194 @@
 #include <vector>
 #include <string>
 #include <map>
+#include <unordered_map>
 #include <algorithm>
 #include <cmath>
 #include <queue>
+#include "feature_matrix.h"
+#include "top_k.h"
+#include "distance_kernels.h"
+#include "thread_pool.h"
+#include "spatial_index.h"
+#include "hnsw_index.h"
+#include "data_processor.h"
+#include "csv_batch_reader.h"
+#include "classification_metrics.h"
+#include <functional>
 
 class KNNClassifier {
+public:
+    // Порядок обхода обучающей выборки при вычислении расстояний
+    enum class ScanLayout {
+        RowMajor,    // строка за строкой (по умолчанию)
+        ColumnMajor  // столбец за столбцом, векторизация по строкам
+    };
+
+    // Способ поиска соседей; все варианты возвращают одних и тех же соседей
+    enum class IndexType {
+        Auto,        // перебор на малых выборках, иначе KD- или VP-дерево
+        BruteForce,  // линейный просмотр всей выборки
+        KDTree,
+        VPTree,
+        HNSW         // приближенный поиск: быстрее, но возможна потеря соседей
+    };
+
+    // Точность хранения обучающих признаков
+    enum class Precision {
+        Float64,     // double, все индексы и пакетный путь
+        Float32,     // float: вдвое меньше памяти, вдвое шире SIMD
+        UInt8        // квантование в 256 уровней общего диапазона признаков
+    };
+
 private:
-    std::vector<std::vector<double>> training_data;
-    std::vector<std::string> training_labels;
+    // Обучающая выборка: непрерывная выровненная матрица и номера классов
+    FeatureMatrix training_matrix;
+    AlignedBuffer<double> training_norms;   // ||x||^2 строк для пакетного пути
+    AlignedBuffer<int32_t> training_class_ids;
+    // Копии пониженной точности; при них матрица double не хранится.
+    // precision - настройка для следующего fit, stored_precision - формат,
+    // в котором хранится текущая обучающая выборка
+    Precision precision;
+    Precision stored_precision;
+    AlignedMatrix<float> training_f32;
+    AlignedMatrix<uint8_t> training_u8;
+    double quant_min;    // значение признака ~ quant_min + code * quant_step
+    double quant_step;
+    std::vector<std::string> class_names;
+    std::unordered_map<std::string, int> class_index;
+    // Нормализация обучающих данных; сохраняется вместе с моделью
+    DataProcessor::NormalizationParams normalization_params;
     int n_features;
-    
-    struct DistanceLabel {
-        double distance;
-        std::string label;
-        
-        bool operator<(const DistanceLabel& other) const {
-            return distance < other.distance;
+    ScanLayout scan_layout;
+    const DistanceKernels* kernels;
+    IndexType index_type;
+    std::shared_ptr<NeighbourIndex> index;
+    HNSWParams hnsw_params;
+    // Собственный пул при явно заданном числе потоков, иначе общий
+    std::shared_ptr<ThreadPool> own_pool;
+    size_t num_threads;
+    size_t batch_threshold;
+
+    // Рабочие буферы одного запроса; по одному на поток, переиспользуются
+    struct QueryScratch;
+    static QueryScratch& threadScratch();
+
+    // Пакет запросов: массив векторов либо строки матрицы признаков
+    // (все подряд или выбранные номерами rows)
+    struct SampleRows {
+        const std::vector<double>* vectors;
+        const FeatureMatrix* matrix;
+        size_t count;
+        const uint32_t* rows = nullptr;
+
+        const double* data(size_t i) const {
+            return matrix ? matrix->row(rows ? rows[i] : i) : vectors[i].data();
         }
+        size_t length(size_t i) const { return matrix ? matrix->cols() : vectors[i].size(); }
     };
-    
-    double calculateDistance(const std::vector<double>& a, const std::vector<double>& b);
-    
+
+    // Квадрат расстояния: для ранжирования соседей корень не нужен
+    double squaredDistance(const double* a, const double* b) const;
+    void computeDistances(const double* query, std::vector<double>& distances) const;
+    void computeReducedDistances(const double* sample, size_t length, QueryScratch& scratch) const;
+    int voteClassId(const std::vector<Neighbour>& neighbours, QueryScratch& scratch) const;
+    void findNearest(const double* sample, size_t length, size_t k, QueryScratch& scratch) const;
+    int predictClassId(const double* sample, size_t length, int k) const;
+    // Кодирование, пониженная точность, нормы и индекс по training_matrix
+    void prepareTraining();
+    void buildIndex();
+    void updateColumnMajor();
+    // Отбор k ближайших среди кандидатов блочного пути по точным расстояниям
+    void rerankCandidates(const double* query, std::vector<Neighbour>& candidates,
+                          size_t k, QueryScratch& scratch) const;
+    void predictBlockGemm(const SampleRows& samples,
+                          size_t begin, size_t end, int k, std::vector<int>& class_ids) const;
+    // Предсказание пакета (параллельно, отрезками); consume(begin, end, ids)
+    // вызывается для каждого отрезка сразу после его предсказания
+    void runBatch(const SampleRows& samples, int k,
+                  const std::function<void(size_t, size_t, const std::vector<int>&)>& consume,
+                  std::vector<int>& class_ids);
+    std::vector<int> predictClassIds(const SampleRows& samples, int k);
+    ConfusionMatrix emptyConfusion() const;
+    void evaluateRows(const SampleRows& samples, const int32_t* actual, int k,
+                      ConfusionMatrix& total);
+    ThreadPool* pool();
+
 public:
     KNNClassifier();
-    void fit(const std::vector<std::vector<double>>& data, 
+    void fit(const std::vector<std::vector<double>>& data,
              const std::vector<std::string>& labels);
+    // Номера классов модели совпадают с data.label_encoding, поэтому
+    // data.label_ids и предсказания можно сравнивать без строк. Если номера
+    // не согласованы со словарем, метки кодируются заново по data.labels.
+    void fit(const DataProcessor::NetworkTrafficData& data);
+    // Обучение на представлении таблицы (строки копируются в модель)
+    void fit(const DataProcessor::DatasetView& data);
+    void setScanLayout(ScanLayout layout);
+    // Принудительный выбор SIMD-ядер (по умолчанию - по возможностям CPU)
+    void setSimdLevel(SimdLevel level);
+    const char* simdName() const { return kernels->name; }
+    // Выбор индекса; при уже обученной модели индекс перестраивается
+    void setIndexType(IndexType type);
+    const char* indexName() const { return index ? index->name() : "brute-force"; }
+    // Параметры HNSW (M и ef_construction требуют перестроения графа)
+    void setHNSWParams(const HNSWParams& params);
+    void setEfSearch(size_t ef);
+    // Число потоков для predictBatch/calculateF1Score:
+    // 0 - общий пул по числу ядер, 1 - последовательно, n - свой пул из n потоков
+    void setNumThreads(size_t n);
+    // Минимальный размер пакета для блочного (GEMM) вычисления расстояний
+    // ||q||^2 + ||x||^2 - 2 q.x при полном переборе; 0 - отключить.
+    // Блочные расстояния только отбирают кандидатов (с запасом на погрешность
+    // округления), окончательный порядок соседей дает точное ядро, поэтому
+    // результат и разрешение равенств совпадают с predict.
+    void setBatchThreshold(size_t n);
+    // Точность хранения применяется при следующем fit. Float32 и UInt8
+    // работают только полным перебором (индексы и GEMM-путь - для double).
+    void setPrecision(Precision p);
+    // Формат текущей обучающей выборки (до fit может отличаться от setPrecision)
+    Precision storagePrecision() const { return stored_precision; }
+    // Объем памяти, занятой обучающей выборкой, в байтах
+    size_t memoryFootprint() const;
+    void setNormalization(const DataProcessor::NormalizationParams& params);
+    const DataProcessor::NormalizationParams& normalization() const { return normalization_params; }
+
+    // Двоичный формат модели (см. knn_model_io.cpp). load() отображает файл
+    // в память и использует матрицу признаков и индекс прямо из него.
+    bool save(const std::string& filename) const;
+    bool load(const std::string& filename);
+
     std::string predict(const std::vector<double>& sample, int k);
+    // k ближайших строк обучающей выборки (квадраты расстояний, по возрастанию)
+    std::vector<Neighbour> findNeighbours(const std::vector<double>& sample, int k) const;
+    // То же для length значений по адресу sample, результат - в out
+    void findNeighbours(const double* sample, size_t length, int k,
+                        std::vector<Neighbour>& out) const;
     std::vector<std::string> predictBatch(const std::vector<std::vector<double>>& samples, int k);
+    // Пакет в виде матрицы (например, из CSVBatchReader)
+    std::vector<std::string> predictBatch(const FeatureMatrix& samples, int k);
+    // Номера классов (индексы в classNames()) для строк матрицы
+    std::vector<int> predictClassIds(const FeatureMatrix& samples, int k);
+    std::vector<int> predictClassIds(const DataProcessor::DatasetView& samples, int k);
+    // Номера классов модели для меток (-1 - неизвестная метка)
+    std::vector<int32_t> encodeLabels(const std::vector<std::string>& labels) const;
+    // Матрица ошибок за один параллельный проход: каждый отрезок запросов
+    // считает свою матрицу, матрицы складываются
+    ConfusionMatrix evaluate(const std::vector<std::vector<double>>& test_data,
+                             const std::vector<int32_t>& test_class_ids, int k);
+    ConfusionMatrix evaluate(const DataProcessor::NetworkTrafficData& test_data, int k);
+    ConfusionMatrix evaluate(const DataProcessor::DatasetView& test_data, int k);
+    ConfusionMatrix evaluate(CSVBatchReader& reader, int k);
+    // Макро-F1 (ConfusionMatrix::macroF1 по классам обучающей выборки)
     double calculateF1Score(const std::vector<std::vector<double>>& test_data,
                            const std::vector<std::string>& test_labels,
                            int k);
+    double calculateF1Score(const DataProcessor::DatasetView& test_data, int k);
+    // F1 по потоку пакетов: в памяти находится только текущий пакет
+    double calculateF1Score(CSVBatchReader& reader, int k);
+
+    size_t trainingSize() const { return training_class_ids.size(); }
+    const std::vector<std::string>& classNames() const { return class_names; }
 };
 
 #endif
\ No newline at end of file
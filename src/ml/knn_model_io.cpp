@@ -0,0 +1,389 @@
+#include "knn_classifier.h"
+#include "mapped_file.h"
+#include <fstream>
+#include <iostream>
+#include <cstring>
+#include <cstdio>
+#include <limits>
+
+// Формат файла модели KNN (версия 1, порядок байт - родной для машины):
+//
+//   FileHeader                     64 байта
+//   SectionEntry[section_count]    таблица секций
+//   секции, каждая с границы 64 байт
+//
+// Секции хранят массивы ровно в том виде, в каком они лежат в памяти
+// классификатора (строки дополнены до stride), поэтому load() не разбирает
+// и не копирует их, а создает представления поверх отображенного файла.
+
+namespace {
+
+const char MODEL_MAGIC[8] = {'K', 'N', 'N', 'M', 'O', 'D', 'E', 'L'};
+const uint32_t MODEL_VERSION = 1;
+const uint64_t ENDIAN_TAG = 0x0102030405060708ULL;
+const size_t SECTION_ALIGNMENT = 64;
+
+enum SectionType : uint32_t {
+    SECTION_META = 1,
+    SECTION_FEATURES = 2,     // строки признаков (double, float или uint8)
+    SECTION_COLUMNS = 3,      // column-major копия (double), необязательна
+    SECTION_NORMS = 4,        // ||x||^2 строк (double)
+    SECTION_CLASS_IDS = 5,    // int32 на строку
+    SECTION_LABELS = 6,       // для каждого класса: uint32 длина + байты имени
+    SECTION_NORM_MINS = 7,    // параметры нормализации (double)
+    SECTION_NORM_MAXS = 8,
+    SECTION_INDEX_BLOB = 9    // массивы индекса в порядке exportBlobs()
+};
+
+enum IndexKind : uint32_t {
+    INDEX_NONE = 0,
+    INDEX_KD_TREE = 1,
+    INDEX_VP_TREE = 2,
+    INDEX_HNSW = 3
+};
+
+struct FileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t section_count;
+    uint64_t endian_tag;
+    uint64_t file_size;
+    uint64_t reserved[4];
+};
+
+struct SectionEntry {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t bytes;
+};
+
+struct ModelMeta {
+    uint64_t n_rows;
+    uint64_t n_cols;
+    uint64_t row_stride;
+    uint64_t column_stride;
+    uint64_t batch_threshold;
+    uint32_t precision;
+    uint32_t index_type;
+    uint32_t index_kind;
+    uint32_t n_classes;
+    double quant_min;
+    double quant_step;
+};
+
+struct Section {
+    uint32_t type;
+    const void* data;
+    size_t bytes;
+};
+
+size_t alignUp(size_t value) {
+    return (value + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT;
+}
+
+uint32_t indexKind(const NeighbourIndex* index) {
+    if (dynamic_cast<const KDTree*>(index)) return INDEX_KD_TREE;
+    if (dynamic_cast<const VPTree*>(index)) return INDEX_VP_TREE;
+    if (dynamic_cast<const HNSWIndex*>(index)) return INDEX_HNSW;
+    return INDEX_NONE;
+}
+
+} // namespace
+
+bool KNNClassifier::save(const std::string& filename) const {
+    if (training_class_ids.empty()) {
+        std::cerr << "Error: cannot save an untrained model" << std::endl;
+        return false;
+    }
+
+    ModelMeta meta = {};
+    meta.n_rows = training_class_ids.size();
+    meta.n_cols = static_cast<uint64_t>(n_features);
+    meta.batch_threshold = batch_threshold;
+    meta.precision = static_cast<uint32_t>(stored_precision);
+    meta.index_type = static_cast<uint32_t>(index_type);
+    meta.index_kind = indexKind(index.get());
+    meta.n_classes = static_cast<uint32_t>(class_names.size());
+    meta.quant_min = quant_min;
+    meta.quant_step = quant_step;
+
+    std::vector<Section> sections;
+    sections.push_back({SECTION_META, &meta, sizeof(meta)});
+
+    if (stored_precision == Precision::Float32) {
+        meta.row_stride = training_f32.stride();
+        sections.push_back({SECTION_FEATURES, training_f32.data(),
+                            training_f32.rows() * training_f32.stride() * sizeof(float)});
+    } else if (stored_precision == Precision::UInt8) {
+        meta.row_stride = training_u8.stride();
+        sections.push_back({SECTION_FEATURES, training_u8.data(),
+                            training_u8.rows() * training_u8.stride() * sizeof(uint8_t)});
+    } else {
+        meta.row_stride = training_matrix.stride();
+        sections.push_back({SECTION_FEATURES, training_matrix.data(),
+                            training_matrix.rows() * training_matrix.stride() * sizeof(double)});
+        if (training_matrix.hasColumnMajor()) {
+            meta.column_stride = training_matrix.columnStride();
+            sections.push_back({SECTION_COLUMNS, training_matrix.column(0),
+                                training_matrix.cols() * training_matrix.columnStride() * sizeof(double)});
+        }
+        sections.push_back({SECTION_NORMS, training_norms.data(),
+                            training_norms.size() * sizeof(double)});
+    }
+
+    sections.push_back({SECTION_CLASS_IDS, training_class_ids.data(),
+                        training_class_ids.size() * sizeof(int32_t)});
+
+    std::vector<uint8_t> labels;
+    for (const auto& name : class_names) {
+        uint32_t length = static_cast<uint32_t>(name.size());
+        const uint8_t* raw = reinterpret_cast<const uint8_t*>(&length);
+        labels.insert(labels.end(), raw, raw + sizeof(length));
+        labels.insert(labels.end(), name.begin(), name.end());
+    }
+    sections.push_back({SECTION_LABELS, labels.data(), labels.size()});
+
+    sections.push_back({SECTION_NORM_MINS, normalization_params.mins.data(),
+                        normalization_params.mins.size() * sizeof(double)});
+    sections.push_back({SECTION_NORM_MAXS, normalization_params.maxs.data(),
+                        normalization_params.maxs.size() * sizeof(double)});
+
+    if (index) {
+        for (const auto& blob : index->exportBlobs()) {
+            sections.push_back({SECTION_INDEX_BLOB, blob.data, blob.bytes});
+        }
+    }
+
+    // Размещение секций
+    std::vector<SectionEntry> table(sections.size());
+    size_t offset = alignUp(sizeof(FileHeader) + sections.size() * sizeof(SectionEntry));
+    for (size_t i = 0; i < sections.size(); ++i) {
+        table[i] = {sections[i].type, 0, offset, sections[i].bytes};
+        offset = alignUp(offset + sections[i].bytes);
+    }
+
+    FileHeader header = {};
+    std::memcpy(header.magic, MODEL_MAGIC, sizeof(MODEL_MAGIC));
+    header.version = MODEL_VERSION;
+    header.section_count = static_cast<uint32_t>(sections.size());
+    header.endian_tag = ENDIAN_TAG;
+    header.file_size = offset;
+
+    // Запись во временный файл и замена переименованием: модель по этому
+    // пути может быть отображена в память (в том числе этим же объектом),
+    // и перезапись файла на месте привела бы к SIGBUS у читателей
+    const std::string temp_name = filename + ".tmp";
+    std::ofstream file(temp_name, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        std::cerr << "Error: Could not open file " << temp_name << std::endl;
+        return false;
+    }
+
+    const char zeros[SECTION_ALIGNMENT] = {};
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(SectionEntry));
+    size_t written = sizeof(header) + table.size() * sizeof(SectionEntry);
+    for (size_t i = 0; i < sections.size(); ++i) {
+        file.write(zeros, table[i].offset - written);
+        file.write(static_cast<const char*>(sections[i].data), sections[i].bytes);
+        written = table[i].offset + sections[i].bytes;
+    }
+    file.write(zeros, offset - written);
+    file.flush();
+
+    if (!file) {
+        std::cerr << "Error: Could not write model to " << temp_name << std::endl;
+        std::remove(temp_name.c_str());
+        return false;
+    }
+    file.close();
+    if (!MappedFile::replace(temp_name, filename)) {
+        std::cerr << "Error: Could not replace " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool KNNClassifier::load(const std::string& filename) {
+    std::shared_ptr<MappedFile> file = MappedFile::open(filename);
+    if (!file) {
+        std::cerr << "Error: Could not open file " << filename << std::endl;
+        return false;
+    }
+
+    auto fail = [&filename](const char* reason) {
+        std::cerr << "Error: invalid model file " << filename << ": " << reason << std::endl;
+        return false;
+    };
+
+    const uint8_t* base = file->data();
+    if (file->size() < sizeof(FileHeader)) return fail("too short");
+
+    FileHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, MODEL_MAGIC, sizeof(MODEL_MAGIC)) != 0) return fail("bad magic");
+    if (header.version != MODEL_VERSION) return fail("unsupported version");
+    if (header.endian_tag != ENDIAN_TAG) return fail("byte order mismatch");
+    if (header.file_size != file->size()) return fail("truncated");
+
+    size_t table_end = sizeof(FileHeader) + header.section_count * sizeof(SectionEntry);
+    if (table_end > file->size()) return fail("truncated section table");
+
+    std::vector<Section> sections;
+    for (uint32_t i = 0; i < header.section_count; ++i) {
+        SectionEntry entry;
+        std::memcpy(&entry, base + sizeof(FileHeader) + i * sizeof(SectionEntry), sizeof(entry));
+        if (entry.offset % SECTION_ALIGNMENT != 0 || entry.offset > file->size() ||
+            entry.bytes > file->size() - entry.offset) {
+            return fail("section out of bounds");
+        }
+        sections.push_back({entry.type, base + entry.offset, static_cast<size_t>(entry.bytes)});
+    }
+
+    auto find = [&sections](uint32_t type) -> const Section* {
+        for (const auto& section : sections) {
+            if (section.type == type) return &section;
+        }
+        return nullptr;
+    };
+
+    const Section* meta_section = find(SECTION_META);
+    if (!meta_section || meta_section->bytes != sizeof(ModelMeta)) return fail("missing metadata");
+    ModelMeta meta;
+    std::memcpy(&meta, meta_section->data, sizeof(meta));
+    if (meta.precision > static_cast<uint32_t>(Precision::UInt8)) return fail("unknown precision");
+    if (meta.index_type > static_cast<uint32_t>(IndexType::HNSW)) return fail("unknown index type");
+    if (meta.index_kind > INDEX_HNSW ||
+        (meta.index_kind != INDEX_NONE && meta.precision != static_cast<uint32_t>(Precision::Float64))) {
+        return fail("bad index kind");
+    }
+    Precision new_precision = static_cast<Precision>(meta.precision);
+
+    // Строки хранятся дополненными до длины, кратной кэш-линии: ядра читают
+    // их целыми регистрами. Размеры из файла проверяются до умножения.
+    size_t element_size = new_precision == Precision::Float32 ? sizeof(float)
+                        : new_precision == Precision::UInt8 ? sizeof(uint8_t)
+                        : sizeof(double);
+    size_t padded = new_precision == Precision::Float32 ? AlignedMatrix<float>::paddedWidth(meta.n_cols)
+                  : new_precision == Precision::UInt8 ? AlignedMatrix<uint8_t>::paddedWidth(meta.n_cols)
+                  : FeatureMatrix::paddedWidth(meta.n_cols);
+    const Section* features = find(SECTION_FEATURES);
+    const Section* class_ids = find(SECTION_CLASS_IDS);
+    const Section* labels = find(SECTION_LABELS);
+    if (meta.n_cols > static_cast<uint64_t>(std::numeric_limits<int>::max()) ||
+        meta.row_stride != padded || meta.n_rows > std::numeric_limits<uint32_t>::max() ||
+        (meta.row_stride > 0 && meta.n_rows > file->size() / (meta.row_stride * element_size))) {
+        return fail("bad dimensions");
+    }
+    size_t n_elements = meta.n_rows * meta.row_stride;
+    if (!features || features->bytes != n_elements * element_size) return fail("bad feature matrix");
+    if (!class_ids || class_ids->bytes != meta.n_rows * sizeof(int32_t)) return fail("bad class ids");
+    if (!labels) return fail("missing labels");
+
+    // Словарь меток - единственное, что разбирается при загрузке
+    std::vector<std::string> names;
+    const uint8_t* cursor = static_cast<const uint8_t*>(labels->data);
+    const uint8_t* labels_end = cursor + labels->bytes;
+    for (uint32_t c = 0; c < meta.n_classes; ++c) {
+        uint32_t length;
+        if (labels_end - cursor < static_cast<ptrdiff_t>(sizeof(length))) return fail("bad labels");
+        std::memcpy(&length, cursor, sizeof(length));
+        cursor += sizeof(length);
+        if (labels_end - cursor < static_cast<ptrdiff_t>(length)) return fail("bad labels");
+        names.emplace_back(reinterpret_cast<const char*>(cursor), length);
+        cursor += length;
+    }
+
+    std::shared_ptr<const void> owner = file;
+    AlignedBuffer<int32_t> ids = AlignedBuffer<int32_t>::view(class_ids->data, meta.n_rows, owner);
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (ids[i] < 0 || static_cast<uint32_t>(ids[i]) >= meta.n_classes) return fail("bad class id");
+    }
+
+    // Представления собираются в локальных переменных: при любой ошибке
+    // ниже состояние классификатора остается прежним
+    FeatureMatrix matrix;
+    AlignedMatrix<float> matrix_f32;
+    AlignedMatrix<uint8_t> matrix_u8;
+    AlignedBuffer<double> norms;
+    if (new_precision == Precision::Float32) {
+        matrix_f32 = AlignedMatrix<float>::fromBuffers(
+            AlignedBuffer<float>::view(features->data, n_elements, owner),
+            meta.n_rows, meta.n_cols, meta.row_stride);
+    } else if (new_precision == Precision::UInt8) {
+        matrix_u8 = AlignedMatrix<uint8_t>::fromBuffers(
+            AlignedBuffer<uint8_t>::view(features->data, n_elements, owner),
+            meta.n_rows, meta.n_cols, meta.row_stride);
+    } else {
+        // Column-major копия необязательна: при несовпадении размеров
+        // она строится заново в updateColumnMajor()
+        AlignedBuffer<double> columns;
+        size_t column_stride = FeatureMatrix::paddedWidth(meta.n_rows);
+        const Section* column_section = find(SECTION_COLUMNS);
+        if (column_section && meta.column_stride == column_stride &&
+            column_section->bytes == meta.n_cols * column_stride * sizeof(double)) {
+            columns = AlignedBuffer<double>::view(column_section->data,
+                                                  meta.n_cols * column_stride, owner);
+        }
+        matrix = FeatureMatrix::fromBuffers(
+            AlignedBuffer<double>::view(features->data, n_elements, owner),
+            meta.n_rows, meta.n_cols, meta.row_stride, columns, column_stride);
+
+        const Section* norm_section = find(SECTION_NORMS);
+        if (!norm_section || norm_section->bytes != meta.n_rows * sizeof(double)) return fail("bad norms");
+        norms = AlignedBuffer<double>::view(norm_section->data, meta.n_rows, owner);
+    }
+
+    DataProcessor::NormalizationParams new_normalization;
+    const Section* mins = find(SECTION_NORM_MINS);
+    const Section* maxs = find(SECTION_NORM_MAXS);
+    if (mins && maxs && mins->bytes == maxs->bytes) {
+        const double* lo = static_cast<const double*>(mins->data);
+        const double* hi = static_cast<const double*>(maxs->data);
+        new_normalization.mins.assign(lo, lo + mins->bytes / sizeof(double));
+        new_normalization.maxs.assign(hi, hi + maxs->bytes / sizeof(double));
+    }
+
+    std::shared_ptr<NeighbourIndex> new_index;
+    if (meta.index_kind != INDEX_NONE) {
+        std::vector<NeighbourIndex::Blob> blobs;
+        for (const auto& section : sections) {
+            if (section.type == SECTION_INDEX_BLOB) {
+                blobs.push_back({section.data, section.bytes});
+            }
+        }
+        if (meta.index_kind == INDEX_KD_TREE) {
+            new_index = std::make_shared<KDTree>();
+        } else if (meta.index_kind == INDEX_VP_TREE) {
+            new_index = std::make_shared<VPTree>();
+        } else {
+            new_index = std::make_shared<HNSWIndex>(hnsw_params);
+        }
+        if (!new_index->importBlobs(blobs, owner, matrix)) return fail("bad index");
+    }
+
+    // Файл корректен - состояние классификатора заменяется
+    precision = new_precision;
+    stored_precision = new_precision;
+    index_type = static_cast<IndexType>(meta.index_type);
+    batch_threshold = meta.batch_threshold;
+    n_features = static_cast<int>(meta.n_cols);
+    quant_min = meta.quant_min;
+    quant_step = meta.quant_step;
+    training_class_ids = std::move(ids);
+    class_names = std::move(names);
+    class_index.clear();
+    for (size_t c = 0; c < class_names.size(); ++c) {
+        class_index[class_names[c]] = static_cast<int>(c);
+    }
+    training_matrix = std::move(matrix);
+    training_f32 = std::move(matrix_f32);
+    training_u8 = std::move(matrix_u8);
+    training_norms = std::move(norms);
+    normalization_params = std::move(new_normalization);
+    index = std::move(new_index);
+
+    updateColumnMajor();
+    return true;
+}
@@ -0,0 +1,243 @@
+#include "sliding_window_knn.h"
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+
+namespace {
+
+// Рабочие буферы запроса; по одному на поток
+struct WindowScratch {
+    AlignedBuffer<double> query;
+    TopK heap;
+    std::vector<Neighbour> neighbours;
+    std::vector<int> votes;
+    std::vector<size_t> first_rank;
+};
+
+WindowScratch& windowScratch() {
+    static thread_local WindowScratch scratch;
+    return scratch;
+}
+
+}
+
+SlidingWindowKNN::Segment::Segment(size_t capacity, size_t n_features, uint64_t first)
+    : rows(capacity, n_features), class_ids(capacity, 0), timestamps(capacity, 0),
+      first_sequence(first) {}
+
+SlidingWindowKNN::SlidingWindowKNN(size_t n_features, size_t max_rows, size_t segment_rows)
+    : n_features(n_features), segment_rows(std::max<size_t>(segment_rows, 1)),
+      max_rows(max_rows), max_age(0), kernels(&distanceKernels()), next_sequence(0) {
+    auto initial = std::make_shared<Snapshot>();
+    initial->begin = 0;
+    initial->end = 0;
+    initial->size = 0;
+    initial->epoch = 0;
+    initial->class_names = std::make_shared<const std::vector<std::string>>();
+    current = initial;
+}
+
+std::shared_ptr<const SlidingWindowKNN::Snapshot> SlidingWindowKNN::snapshot() const {
+    return std::atomic_load(&current);
+}
+
+void SlidingWindowKNN::publish(const std::shared_ptr<const Snapshot>& next) {
+    std::atomic_store(&current, next);
+}
+
+void SlidingWindowKNN::setMaxAge(int64_t age) {
+    std::lock_guard<std::mutex> lock(writer_mutex);
+    max_age = age;
+}
+
+void SlidingWindowKNN::setMaxRows(size_t rows) {
+    std::lock_guard<std::mutex> lock(writer_mutex);
+    max_rows = rows;
+}
+
+void SlidingWindowKNN::partialFit(const std::vector<std::vector<double>>& data,
+                                  const std::vector<std::string>& labels, int64_t timestamp) {
+    if (data.size() != labels.size()) {
+        std::cerr << "Error: " << data.size() << " rows but " << labels.size() << " labels" << std::endl;
+        return;
+    }
+    if (data.empty()) return;
+
+    std::lock_guard<std::mutex> lock(writer_mutex);
+    auto next = std::make_shared<Snapshot>(*snapshot());
+
+    // Словарь классов копируется, только если появилась новая метка
+    std::shared_ptr<std::vector<std::string>> names;
+    for (size_t i = 0; i < data.size(); ++i) {
+        auto found = class_index.find(labels[i]);
+        int32_t class_id;
+        if (found != class_index.end()) {
+            class_id = found->second;
+        } else {
+            if (!names) names = std::make_shared<std::vector<std::string>>(*next->class_names);
+            class_id = static_cast<int32_t>(names->size());
+            names->push_back(labels[i]);
+            class_index.emplace(labels[i], class_id);
+        }
+
+        if (next->segments.empty() || next->end == segment_rows) {
+            if (next->size == 0) next->segments.clear();
+            next->segments.push_back(std::make_shared<Segment>(segment_rows, n_features,
+                                                               next_sequence));
+            if (next->segments.size() == 1) next->begin = 0;
+            next->end = 0;
+        }
+
+        // Строка за концом опубликованного окна не видна читателям,
+        // поэтому запись в нее не требует синхронизации
+        Segment& segment = *next->segments.back();
+        double* dst = segment.rows.row(next->end);
+        size_t n = std::min(n_features, data[i].size());
+        std::copy(data[i].begin(), data[i].begin() + n, dst);
+        segment.class_ids[next->end] = class_id;
+        segment.timestamps[next->end] = timestamp;
+        ++next->end;
+        ++next->size;
+        ++next_sequence;
+    }
+    if (names) next->class_names = names;
+
+    if (max_rows > 0 && next->size > max_rows) {
+        evictLocked(*next, next->size - max_rows);
+    }
+    if (max_age > 0) {
+        evictLocked(*next, countOlderThan(*next, timestamp - max_age));
+    }
+    ++next->epoch;
+    publish(next);
+}
+
+size_t SlidingWindowKNN::countOlderThan(const Snapshot& snap, int64_t cutoff) const {
+    // Отметки не убывают, поэтому устаревшие строки образуют начало окна
+    size_t count = 0;
+    for (size_t s = 0; s < snap.segments.size(); ++s) {
+        const Segment& segment = *snap.segments[s];
+        size_t first = s == 0 ? snap.begin : 0;
+        size_t last = s + 1 == snap.segments.size() ? snap.end : segment_rows;
+        for (size_t r = first; r < last; ++r) {
+            if (segment.timestamps[r] >= cutoff) return count;
+            ++count;
+        }
+    }
+    return count;
+}
+
+void SlidingWindowKNN::evictLocked(Snapshot& next, size_t count) {
+    count = std::min(count, next.size);
+    next.size -= count;
+    while (count > 0) {
+        bool last = next.segments.size() == 1;
+        size_t in_front = (last ? next.end : segment_rows) - next.begin;
+        if (count < in_front || last) {
+            next.begin += std::min(count, in_front);
+            break;
+        }
+        // Сегмент целиком вышел из окна; старые снимки держат его сами
+        count -= in_front;
+        next.segments.erase(next.segments.begin());
+        next.begin = 0;
+    }
+}
+
+void SlidingWindowKNN::evict(size_t count) {
+    std::lock_guard<std::mutex> lock(writer_mutex);
+    auto next = std::make_shared<Snapshot>(*snapshot());
+    evictLocked(*next, count);
+    ++next->epoch;
+    publish(next);
+}
+
+void SlidingWindowKNN::evictOlderThan(int64_t cutoff) {
+    std::lock_guard<std::mutex> lock(writer_mutex);
+    auto next = std::make_shared<Snapshot>(*snapshot());
+    evictLocked(*next, countOlderThan(*next, cutoff));
+    ++next->epoch;
+    publish(next);
+}
+
+int SlidingWindowKNN::predictWith(const Snapshot& snap, const std::vector<double>& sample,
+                                  int k) const {
+    if (snap.size == 0 || k <= 0) return -1;
+
+    WindowScratch& scratch = windowScratch();
+    size_t stride = FeatureMatrix::paddedWidth(n_features);
+    if (scratch.query.size() < stride) {
+        scratch.query = AlignedBuffer<double>(stride);
+    }
+    std::fill_n(scratch.query.data(), scratch.query.size(), 0.0);
+    std::copy_n(sample.data(), std::min(n_features, sample.size()), scratch.query.data());
+
+    // Номер соседа - сквозной номер строки: при равных расстояниях
+    // побеждает более старая строка, как меньший номер в KNNClassifier
+    scratch.heap.reset(static_cast<size_t>(k));
+    for (size_t s = 0; s < snap.segments.size(); ++s) {
+        const Segment& segment = *snap.segments[s];
+        size_t first = s == 0 ? snap.begin : 0;
+        size_t last = s + 1 == snap.segments.size() ? snap.end : segment_rows;
+        for (size_t r = first; r < last; ++r) {
+            double distance = kernels->squaredL2(scratch.query.data(), segment.rows.row(r), stride);
+            if (!scratch.heap.full() || distance <= scratch.heap.bound()) {
+                scratch.heap.push(distance, segment.first_sequence + r);
+            }
+        }
+    }
+    scratch.heap.sortedInto(scratch.neighbours);
+
+    // Голосование с тем же правилом равенства, что и в KNNClassifier
+    size_t n_classes = snap.class_names->size();
+    uint64_t base = snap.segments.front()->first_sequence;
+    scratch.votes.assign(n_classes, 0);
+    scratch.first_rank.assign(n_classes, scratch.neighbours.size());
+    for (size_t i = 0; i < scratch.neighbours.size(); ++i) {
+        uint64_t offset = scratch.neighbours[i].index - base;
+        const Segment& segment = *snap.segments[offset / segment_rows];
+        int class_id = segment.class_ids[offset % segment_rows];
+        if (scratch.votes[class_id]++ == 0) {
+            scratch.first_rank[class_id] = i;
+        }
+    }
+
+    int best_class = -1;
+    int max_count = 0;
+    for (size_t c = 0; c < n_classes; ++c) {
+        if (scratch.votes[c] > max_count ||
+            (scratch.votes[c] == max_count && max_count > 0 &&
+             scratch.first_rank[c] < scratch.first_rank[best_class])) {
+            max_count = scratch.votes[c];
+            best_class = static_cast<int>(c);
+        }
+    }
+    return best_class;
+}
+
+std::string SlidingWindowKNN::predict(const std::vector<double>& sample, int k) const {
+    auto snap = snapshot();
+    int class_id = predictWith(*snap, sample, k);
+    return class_id >= 0 ? (*snap->class_names)[class_id] : std::string();
+}
+
+std::vector<std::string> SlidingWindowKNN::predictBatch(
+    const std::vector<std::vector<double>>& samples, int k) const {
+    auto snap = snapshot();
+    std::vector<std::string> predictions(samples.size());
+    ThreadPool::shared().parallelFor(0, samples.size(), 64, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            int class_id = predictWith(*snap, samples[i], k);
+            if (class_id >= 0) predictions[i] = (*snap->class_names)[class_id];
+        }
+    });
+    return predictions;
+}
+
+size_t SlidingWindowKNN::size() const {
+    return snapshot()->size;
+}
+
+uint64_t SlidingWindowKNN::epoch() const {
+    return snapshot()->epoch;
+}
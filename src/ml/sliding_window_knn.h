@@ -0,0 +1,90 @@
+#ifndef SLIDING_WINDOW_KNN_H
+#define SLIDING_WINDOW_KNN_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <cstdint>
+#include "feature_matrix.h"
+#include "top_k.h"
+#include "distance_kernels.h"
+#include "thread_pool.h"
+
+// KNN по скользящему окну для живого трафика: новые размеченные потоки
+// добавляются (partialFit), старые вытесняются по числу строк или по
+// возрасту, без переобучения модели.
+//
+// Данные лежат в сегментах фиксированной емкости. Запись идет только в
+// еще не опубликованные строки последнего сегмента, после чего
+// публикуется новый неизменяемый снимок (эпоха): список сегментов и
+// границы окна. predict берет текущий снимок атомарно и не ждет писателей;
+// сегменты, вытесненные из окна, живут, пока их держат старые снимки.
+class SlidingWindowKNN {
+private:
+    struct Segment {
+        FeatureMatrix rows;
+        std::vector<int32_t> class_ids;
+        std::vector<int64_t> timestamps;
+        uint64_t first_sequence;   // сквозной номер первой строки сегмента
+
+        Segment(size_t capacity, size_t n_features, uint64_t first);
+    };
+
+    struct Snapshot {
+        std::vector<std::shared_ptr<Segment>> segments;
+        size_t begin;              // первая строка окна в segments.front()
+        size_t end;                // конец окна в segments.back()
+        size_t size;
+        uint64_t epoch;
+        std::shared_ptr<const std::vector<std::string>> class_names;
+    };
+
+    size_t n_features;
+    size_t segment_rows;
+    size_t max_rows;                           // читаются и меняются под writer_mutex
+    int64_t max_age;
+    const DistanceKernels* kernels;
+    std::shared_ptr<const Snapshot> current;   // читается и заменяется атомарно
+    std::mutex writer_mutex;                   // сериализует partialFit/evict
+    std::unordered_map<std::string, int32_t> class_index;
+    uint64_t next_sequence;
+
+    std::shared_ptr<const Snapshot> snapshot() const;
+    void publish(const std::shared_ptr<const Snapshot>& next);
+    // Вытеснение из начала окна; вызывается под writer_mutex
+    void evictLocked(Snapshot& next, size_t count);
+    size_t countOlderThan(const Snapshot& snap, int64_t cutoff) const;
+    int predictWith(const Snapshot& snap, const std::vector<double>& sample, int k) const;
+
+public:
+    // max_rows - предельный размер окна (0 - без предела),
+    // segment_rows - емкость сегмента
+    explicit SlidingWindowKNN(size_t n_features, size_t max_rows = 0, size_t segment_rows = 4096);
+
+    SlidingWindowKNN(const SlidingWindowKNN&) = delete;
+    SlidingWindowKNN& operator=(const SlidingWindowKNN&) = delete;
+
+    // Окно по времени: при добавлении строки с отметкой t вытесняются строки
+    // старше t - max_age (в единицах отметок; 0 - без ограничения).
+    // Пределы меняются под writer_mutex и действуют со следующего partialFit.
+    void setMaxAge(int64_t age);
+    void setMaxRows(size_t rows);
+
+    // Добавление размеченных строк с отметкой времени (отметки не убывают)
+    void partialFit(const std::vector<std::vector<double>>& data,
+                    const std::vector<std::string>& labels, int64_t timestamp = 0);
+    // Вытеснение count самых старых строк / строк с отметкой меньше cutoff
+    void evict(size_t count);
+    void evictOlderThan(int64_t cutoff);
+
+    std::string predict(const std::vector<double>& sample, int k) const;
+    // Весь пакет обрабатывается на одном снимке, параллельно
+    std::vector<std::string> predictBatch(const std::vector<std::vector<double>>& samples, int k) const;
+
+    size_t size() const;
+    uint64_t epoch() const;
+};
+
+#endif
@@ -0,0 +1,305 @@
+#include "spatial_index.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <cstring>
+
+namespace {
+
+// Запас при отсечении ветвей: нижняя оценка расстояния считается иначе,
+// чем само расстояние, и не должна отсекать соседей из-за округления
+inline double widen(double bound) {
+    return bound * (1.0 + 1e-9) + 1e-12;
+}
+
+template <typename T>
+AlignedBuffer<T> toBuffer(const std::vector<T>& values) {
+    AlignedBuffer<T> buffer(values.size());
+    if (!values.empty()) {
+        std::memcpy(static_cast<void*>(buffer.data()), values.data(), values.size() * sizeof(T));
+    }
+    return buffer;
+}
+
+// Общий формат деревьев: [leaf_size], [узлы], [порядок строк].
+// valid(id, node) проверяет поля узла, специфичные для вида дерева.
+template <typename Node, typename Valid>
+bool importTree(const std::vector<NeighbourIndex::Blob>& blobs,
+                const std::shared_ptr<const void>& owner, size_t n_points,
+                uint64_t& leaf_size, AlignedBuffer<Node>& nodes,
+                AlignedBuffer<uint32_t>& order, Valid valid) {
+    if (blobs.size() != 3 || blobs[0].bytes != sizeof(uint64_t) ||
+        blobs[1].bytes % sizeof(Node) != 0 || blobs[2].bytes != n_points * sizeof(uint32_t)) {
+        return false;
+    }
+    uint64_t new_leaf_size;
+    std::memcpy(&new_leaf_size, blobs[0].data, sizeof(uint64_t));
+    auto new_nodes = AlignedBuffer<Node>::view(blobs[1].data, blobs[1].bytes / sizeof(Node), owner);
+    auto new_order = AlignedBuffer<uint32_t>::view(blobs[2].data, n_points, owner);
+    if (new_leaf_size == 0 || (n_points > 0 && new_nodes.empty()) ||
+        new_nodes.size() > static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+        return false;
+    }
+
+    for (size_t i = 0; i < new_order.size(); ++i) {
+        if (new_order[i] >= n_points) return false;
+    }
+    // Потомки нумеруются после родителя (как при построении), поэтому
+    // обход из корня конечен и не выходит за массив узлов
+    auto child = [&new_nodes](int32_t id, int32_t c) {
+        return c > id && static_cast<size_t>(c) < new_nodes.size();
+    };
+    for (size_t i = 0; i < new_nodes.size(); ++i) {
+        const Node& node = new_nodes[i];
+        if (node.begin > node.end || node.end > n_points ||
+            !valid(static_cast<int32_t>(i), node, child)) {
+            return false;
+        }
+    }
+
+    leaf_size = new_leaf_size;
+    nodes = std::move(new_nodes);
+    order = std::move(new_order);
+    return true;
+}
+
+} // namespace
+
+// ===================== KD-дерево =====================
+
+KDTree::KDTree(size_t leaf_size) : leaf_size(std::max<size_t>(1, leaf_size)) {}
+
+void KDTree::build(const FeatureMatrix& points, SquaredL2Fn /*distance*/) {
+    std::vector<Node> tree;
+    std::vector<uint32_t> rows(points.rows());
+    for (size_t i = 0; i < rows.size(); ++i) {
+        rows[i] = static_cast<uint32_t>(i);
+    }
+    if (!rows.empty()) {
+        buildNode(points, 0, static_cast<uint32_t>(rows.size()), tree, rows);
+    }
+    nodes = toBuffer(tree);
+    order = toBuffer(rows);
+}
+
+std::vector<NeighbourIndex::Blob> KDTree::exportBlobs() const {
+    return {{&leaf_size, sizeof(leaf_size)},
+            {nodes.data(), nodes.size() * sizeof(Node)},
+            {order.data(), order.size() * sizeof(uint32_t)}};
+}
+
+bool KDTree::importBlobs(const std::vector<Blob>& blobs, std::shared_ptr<const void> owner,
+                         const FeatureMatrix& points) {
+    size_t n_cols = points.cols();
+    auto valid = [n_cols](int32_t id, const Node& node, const auto& child) {
+        if (node.split_dim < 0) return true;
+        return static_cast<size_t>(node.split_dim) < n_cols &&
+               child(id, node.left) && child(id, node.right);
+    };
+    return importTree(blobs, owner, points.rows(), leaf_size, nodes, order, valid);
+}
+
+int32_t KDTree::buildNode(const FeatureMatrix& points, uint32_t begin, uint32_t end,
+                          std::vector<Node>& tree, std::vector<uint32_t>& rows) const {
+    int32_t id = static_cast<int32_t>(tree.size());
+    tree.push_back({begin, end, -1, -1, -1, 0.0});
+
+    if (end - begin <= leaf_size) {
+        return id;
+    }
+
+    // Измерение с наибольшим разбросом значений
+    int32_t best_dim = -1;
+    double best_spread = 0.0;
+    for (size_t j = 0; j < points.cols(); ++j) {
+        double lo = std::numeric_limits<double>::max();
+        double hi = std::numeric_limits<double>::lowest();
+        for (uint32_t i = begin; i < end; ++i) {
+            double v = points.at(rows[i], j);
+            lo = std::min(lo, v);
+            hi = std::max(hi, v);
+        }
+        if (hi - lo > best_spread) {
+            best_spread = hi - lo;
+            best_dim = static_cast<int32_t>(j);
+        }
+    }
+    if (best_dim < 0) {
+        return id;  // все точки совпадают
+    }
+
+    uint32_t mid = begin + (end - begin) / 2;
+    std::nth_element(rows.begin() + begin, rows.begin() + mid, rows.begin() + end,
+                     [&points, best_dim](uint32_t a, uint32_t b) {
+                         double va = points.at(a, best_dim);
+                         double vb = points.at(b, best_dim);
+                         return va < vb || (va == vb && a < b);
+                     });
+
+    double split_value = points.at(rows[mid], best_dim);
+    int32_t left = buildNode(points, begin, mid, tree, rows);
+    int32_t right = buildNode(points, mid, end, tree, rows);
+
+    Node& node = tree[id];
+    node.split_dim = best_dim;
+    node.split_value = split_value;
+    node.left = left;
+    node.right = right;
+    return id;
+}
+
+void KDTree::search(const FeatureMatrix& points, SquaredL2Fn distance, int32_t id,
+                    const double* sample, TopK& result) const {
+    const Node& node = nodes[id];
+
+    if (node.split_dim < 0) {
+        for (uint32_t i = node.begin; i < node.end; ++i) {
+            uint32_t row = order[i];
+            double d = distance(sample, points.row(row), points.stride());
+            if (!result.full() || d <= result.bound()) {
+                result.push(d, row);
+            }
+        }
+        return;
+    }
+
+    // Левое поддерево: значения <= split_value, правое: >= split_value
+    double diff = sample[node.split_dim] - node.split_value;
+    int32_t near_child = diff < 0 ? node.left : node.right;
+    int32_t far_child = diff < 0 ? node.right : node.left;
+
+    search(points, distance, near_child, sample, result);
+    if (!result.full() || diff * diff <= widen(result.bound())) {
+        search(points, distance, far_child, sample, result);
+    }
+}
+
+void KDTree::query(const FeatureMatrix& points, SquaredL2Fn distance,
+                   const double* sample, size_t k, TopK& result) const {
+    result.reset(k);
+    if (nodes.empty() || k == 0) return;
+    search(points, distance, 0, sample, result);
+}
+
+// ===================== VP-дерево =====================
+
+VPTree::VPTree(size_t leaf_size) : leaf_size(std::max<size_t>(1, leaf_size)) {}
+
+void VPTree::build(const FeatureMatrix& points, SquaredL2Fn distance) {
+    std::vector<Node> tree;
+    std::vector<uint32_t> rows(points.rows());
+    for (size_t i = 0; i < rows.size(); ++i) {
+        rows[i] = static_cast<uint32_t>(i);
+    }
+    if (!rows.empty()) {
+        std::vector<std::pair<double, uint32_t>> scratch;
+        buildNode(points, distance, 0, static_cast<uint32_t>(rows.size()), tree, rows, scratch);
+    }
+    nodes = toBuffer(tree);
+    order = toBuffer(rows);
+}
+
+std::vector<NeighbourIndex::Blob> VPTree::exportBlobs() const {
+    return {{&leaf_size, sizeof(leaf_size)},
+            {nodes.data(), nodes.size() * sizeof(Node)},
+            {order.data(), order.size() * sizeof(uint32_t)}};
+}
+
+bool VPTree::importBlobs(const std::vector<Blob>& blobs, std::shared_ptr<const void> owner,
+                         const FeatureMatrix& points) {
+    size_t n_points = points.rows();
+    auto valid = [n_points](int32_t id, const Node& node, const auto& child) {
+        if (node.inside < 0) return true;
+        return node.vantage < n_points && child(id, node.inside) && child(id, node.outside);
+    };
+    return importTree(blobs, owner, n_points, leaf_size, nodes, order, valid);
+}
+
+int32_t VPTree::buildNode(const FeatureMatrix& points, SquaredL2Fn distance,
+                          uint32_t begin, uint32_t end,
+                          std::vector<Node>& tree, std::vector<uint32_t>& rows,
+                          std::vector<std::pair<double, uint32_t>>& scratch) const {
+    int32_t id = static_cast<int32_t>(tree.size());
+    tree.push_back({begin, end, 0, -1, -1, 0.0});
+
+    if (end - begin <= leaf_size) {
+        return id;
+    }
+
+    // Опорная точка - середина диапазона (детерминированно), ставится в начало
+    std::swap(rows[begin], rows[begin + (end - begin) / 2]);
+    uint32_t vantage = rows[begin];
+    const double* vp = points.row(vantage);
+
+    scratch.clear();
+    for (uint32_t i = begin + 1; i < end; ++i) {
+        double d = std::sqrt(distance(vp, points.row(rows[i]), points.stride()));
+        scratch.push_back({d, rows[i]});
+    }
+
+    // Ближняя половина - внутри сферы медианного радиуса
+    size_t half = scratch.size() / 2;
+    std::nth_element(scratch.begin(), scratch.begin() + half, scratch.end());
+    double radius = scratch[half].first;
+    for (size_t i = 0; i < scratch.size(); ++i) {
+        rows[begin + 1 + i] = scratch[i].second;
+    }
+
+    uint32_t mid = begin + 1 + static_cast<uint32_t>(half);
+    int32_t inside = buildNode(points, distance, begin + 1, mid, tree, rows, scratch);
+    int32_t outside = buildNode(points, distance, mid, end, tree, rows, scratch);
+
+    Node& node = tree[id];
+    node.vantage = vantage;
+    node.radius = radius;
+    node.inside = inside;
+    node.outside = outside;
+    return id;
+}
+
+void VPTree::search(const FeatureMatrix& points, SquaredL2Fn distance, int32_t id,
+                    const double* sample, TopK& result) const {
+    const Node& node = nodes[id];
+
+    if (node.inside < 0) {
+        for (uint32_t i = node.begin; i < node.end; ++i) {
+            uint32_t row = order[i];
+            double d = distance(sample, points.row(row), points.stride());
+            if (!result.full() || d <= result.bound()) {
+                result.push(d, row);
+            }
+        }
+        return;
+    }
+
+    double squared = distance(sample, points.row(node.vantage), points.stride());
+    if (!result.full() || squared <= result.bound()) {
+        result.push(squared, node.vantage);
+    }
+    double d = std::sqrt(squared);
+
+    // tau - радиус текущего k-го соседа; ветви за пределами d ± tau не нужны
+    auto tau = [&result]() {
+        return result.full() ? widen(std::sqrt(result.bound()))
+                             : std::numeric_limits<double>::infinity();
+    };
+
+    if (d < node.radius) {
+        search(points, distance, node.inside, sample, result);
+        if (d + tau() >= node.radius) {
+            search(points, distance, node.outside, sample, result);
+        }
+    } else {
+        search(points, distance, node.outside, sample, result);
+        if (d - tau() <= node.radius) {
+            search(points, distance, node.inside, sample, result);
+        }
+    }
+}
+
+void VPTree::query(const FeatureMatrix& points, SquaredL2Fn distance,
+                   const double* sample, size_t k, TopK& result) const {
+    result.reset(k);
+    if (nodes.empty() || k == 0) return;
+    search(points, distance, 0, sample, result);
+}
@@ -0,0 +1,107 @@
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include <vector>
+#include <memory>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+#include "feature_matrix.h"
+#include "top_k.h"
+#include "distance_kernels.h"
+
+// Индекс для поиска ближайших соседей по строкам FeatureMatrix.
+// Сама матрица индексу не принадлежит и передается в каждый вызов,
+// расстояния в TopK - квадраты евклидовых, как и при полном переборе.
+class NeighbourIndex {
+public:
+    virtual ~NeighbourIndex() = default;
+    virtual void build(const FeatureMatrix& points, SquaredL2Fn distance) = 0;
+    virtual void query(const FeatureMatrix& points, SquaredL2Fn distance,
+                       const double* sample, size_t k, TopK& result) const = 0;
+    virtual const char* name() const = 0;
+
+    // Сериализация: индекс описывается набором непрерывных массивов.
+    // При загрузке они возвращаются как представления поверх отображенного
+    // файла модели (owner удерживает отображение) и не копируются.
+    // importBlobs проверяет, что все номера строк, узлов и измерений
+    // допустимы для points; при ошибке индекс остается прежним.
+    struct Blob {
+        const void* data;
+        size_t bytes;
+    };
+    virtual std::vector<Blob> exportBlobs() const = 0;
+    virtual bool importBlobs(const std::vector<Blob>& blobs, std::shared_ptr<const void> owner,
+                             const FeatureMatrix& points) = 0;
+};
+
+// KD-дерево: разбиение по медиане измерения с наибольшим разбросом.
+// Эффективно при небольшой размерности (до ~16 признаков).
+class KDTree : public NeighbourIndex {
+private:
+    struct Node {
+        uint32_t begin;       // диапазон order[begin, end) для листа
+        uint32_t end;
+        int32_t split_dim;    // -1 для листа
+        int32_t left;
+        int32_t right;
+        double split_value;
+    };
+
+    AlignedBuffer<Node> nodes;
+    AlignedBuffer<uint32_t> order;
+    uint64_t leaf_size;
+
+    int32_t buildNode(const FeatureMatrix& points, uint32_t begin, uint32_t end,
+                      std::vector<Node>& tree, std::vector<uint32_t>& rows) const;
+    void search(const FeatureMatrix& points, SquaredL2Fn distance, int32_t node,
+                const double* sample, TopK& result) const;
+
+public:
+    explicit KDTree(size_t leaf_size = 16);
+    void build(const FeatureMatrix& points, SquaredL2Fn distance) override;
+    void query(const FeatureMatrix& points, SquaredL2Fn distance,
+               const double* sample, size_t k, TopK& result) const override;
+    const char* name() const override { return "kd-tree"; }
+    std::vector<Blob> exportBlobs() const override;
+    bool importBlobs(const std::vector<Blob>& blobs, std::shared_ptr<const void> owner,
+                     const FeatureMatrix& points) override;
+};
+
+// VP-дерево (vantage point): разбиение по сфере с центром в опорной точке
+// и медианным радиусом. Использует только неравенство треугольника,
+// поэтому не деградирует так сильно, как KD-дерево, на ~40 признаках.
+class VPTree : public NeighbourIndex {
+private:
+    struct Node {
+        uint32_t begin;       // для листа - диапазон order[begin, end)
+        uint32_t end;
+        uint32_t vantage;     // номер опорной строки
+        int32_t inside;       // -1 для листа
+        int32_t outside;
+        double radius;        // медианное (не квадрат) расстояние
+    };
+
+    AlignedBuffer<Node> nodes;
+    AlignedBuffer<uint32_t> order;
+    uint64_t leaf_size;
+
+    int32_t buildNode(const FeatureMatrix& points, SquaredL2Fn distance,
+                      uint32_t begin, uint32_t end,
+                      std::vector<Node>& tree, std::vector<uint32_t>& rows,
+                      std::vector<std::pair<double, uint32_t>>& scratch) const;
+    void search(const FeatureMatrix& points, SquaredL2Fn distance, int32_t node,
+                const double* sample, TopK& result) const;
+
+public:
+    explicit VPTree(size_t leaf_size = 16);
+    void build(const FeatureMatrix& points, SquaredL2Fn distance) override;
+    void query(const FeatureMatrix& points, SquaredL2Fn distance,
+               const double* sample, size_t k, TopK& result) const override;
+    const char* name() const override { return "vp-tree"; }
+    std::vector<Blob> exportBlobs() const override;
+    bool importBlobs(const std::vector<Blob>& blobs, std::shared_ptr<const void> owner,
+                     const FeatureMatrix& points) override;
+};
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef TOP_K_H
+#define TOP_K_H
+
+#include <vector>
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+
+// Сосед: расстояние и номер строки обучающей выборки.
+// При равных расстояниях ближе считается строка с меньшим номером,
+// поэтому порядок соседей полностью детерминирован.
+struct Neighbour {
+    double distance;
+    size_t index;
+
+    bool operator<(const Neighbour& other) const {
+        if (distance != other.distance) return distance < other.distance;
+        return index < other.index;
+    }
+
+    bool operator>(const Neighbour& other) const {
+        return other < *this;
+    }
+};
+
+// Ограниченная max-куча: хранит k ближайших соседей, на вершине - худший
+class TopK {
+private:
+    std::vector<Neighbour> heap;
+    size_t capacity;
+
+public:
+    TopK() : capacity(0) {}
+    explicit TopK(size_t k) : capacity(k) { heap.reserve(k); }
+
+    void reset(size_t k) {
+        heap.clear();
+        capacity = k;
+        heap.reserve(k);
+    }
+
+    size_t size() const { return heap.size(); }
+    bool full() const { return heap.size() >= capacity; }
+    const Neighbour& worst() const { return heap.front(); }
+
+    // Порог отсечения: кандидаты дальше него в кучу не попадут
+    double bound() const {
+        return full() && capacity > 0 ? heap.front().distance
+                                      : std::numeric_limits<double>::infinity();
+    }
+
+    void push(double distance, size_t index) {
+        if (capacity == 0) return;
+        Neighbour candidate{distance, index};
+        if (heap.size() < capacity) {
+            heap.push_back(candidate);
+            std::push_heap(heap.begin(), heap.end());
+        } else if (candidate < heap.front()) {
+            std::pop_heap(heap.begin(), heap.end());
+            heap.back() = candidate;
+            std::push_heap(heap.begin(), heap.end());
+        }
+    }
+
+    // Соседи в порядке возрастания расстояния
+    void sortedInto(std::vector<Neighbour>& out) {
+        out.assign(heap.begin(), heap.end());
+        std::sort(out.begin(), out.end());
+    }
+};
+
+// Выбор k ближайших по готовому массиву расстояний.
+// При малом k используется куча (O(n log k)), иначе nth_element (O(n)).
+inline void selectNearest(const std::vector<double>& distances, size_t k,
+                          TopK& heap, std::vector<Neighbour>& out) {
+    size_t n = distances.size();
+    k = std::min(k, n);
+
+    if (k * 8 >= n) {
+        out.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            out[i] = {distances[i], i};
+        }
+        if (k < n) {
+            std::nth_element(out.begin(), out.begin() + k, out.end());
+            out.resize(k);
+        }
+        std::sort(out.begin(), out.end());
+        return;
+    }
+
+    heap.reset(k);
+    for (size_t i = 0; i < n; ++i) {
+        if (!heap.full() || distances[i] <= heap.bound()) {
+            heap.push(distances[i], i);
+        }
+    }
+    heap.sortedInto(out);
+}
+
+#endif
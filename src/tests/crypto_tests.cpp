@@ -1,7 +1,11 @@
 #include "../crypto/blowfish.h"
+#include "../crypto/blowfish_key_cache.h"
+#include "../crypto/blowfish_stream.h"
 #include <iostream>
 #include <cassert>
 #include <vector>
+#include <algorithm>
+#include <thread>
 
 void testBlowfishBasic() {
     std::cout << "\n=== Testing Blowfish Basic Functionality ===" << std::endl;
@@ -125,6 +129,368 @@ void testBlowfishEdgeCases() {
     std::cout << "✓ Large data test passed" << std::endl;
 }
 
+void testBlowfishBufferAPI() {
+    std::cout << "\n=== Testing Blowfish Buffer API ===" << std::endl;
+    
+    Blowfish blowfish;
+    std::vector<uint8_t> key(16, 0x5A);
+    blowfish.setKey(key);
+    
+    // PKCS#7: дополнение есть всегда, в том числе для целого блока
+    assert(Blowfish::paddedSize(0) == 8);
+    assert(Blowfish::paddedSize(7) == 8);
+    assert(Blowfish::paddedSize(8) == 16);
+    
+    for (size_t size : {0, 1, 7, 8, 9, 64, 255}) {
+        std::vector<uint8_t> packet(size);
+        for (size_t i = 0; i < size; ++i) packet[i] = static_cast<uint8_t>(i * 7 + 3);
+        
+        // Шифрование на месте совпадает с векторным API
+        std::vector<uint8_t> buffer(Blowfish::paddedSize(size));
+        std::copy(packet.begin(), packet.end(), buffer.begin());
+        size_t cipher_length = 0;
+        assert(blowfish.encrypt(buffer.data(), size, buffer.data(), buffer.size(), cipher_length));
+        assert(cipher_length == buffer.size());
+        assert(buffer == blowfish.encrypt(packet));
+        
+        // Расшифровка в отдельный буфер и на месте
+        std::vector<uint8_t> plain(cipher_length);
+        size_t plain_length = 0;
+        assert(blowfish.decrypt(buffer.data(), cipher_length, plain.data(), plain_length));
+        assert(plain_length == size && std::equal(packet.begin(), packet.end(), plain.begin()));
+        assert(blowfish.decrypt(buffer.data(), cipher_length, buffer.data(), plain_length));
+        assert(plain_length == size && std::equal(packet.begin(), packet.end(), buffer.begin()));
+    }
+    std::cout << "✓ In-place and out-of-place round trips" << std::endl;
+    
+    // Ошибки: малый буфер, длина не кратна блоку, испорченное дополнение
+    std::vector<uint8_t> data(16, 0x11);
+    size_t length = 0;
+    assert(!blowfish.encrypt(data.data(), 16, data.data(), 16, length));
+    assert(!blowfish.decrypt(data.data(), 15, data.data(), length));
+    std::vector<uint8_t> bad = {1, 2, 3, 4, 5, 6, 7, 9};
+    assert(!Blowfish::unpaddedSize(bad.data(), bad.size(), length));
+    bad = {1, 2, 3, 4, 5, 3, 2, 3};
+    assert(!Blowfish::unpaddedSize(bad.data(), bad.size(), length));
+    bad = {1, 2, 3, 4, 5, 3, 3, 3};
+    assert(Blowfish::unpaddedSize(bad.data(), bad.size(), length) && length == 5);
+    std::cout << "✓ Padding validation" << std::endl;
+}
+
+void testBlowfishReferenceVectors() {
+    std::cout << "\n=== Testing Blowfish Reference Vectors ===" << std::endl;
+    
+    // Стандартные векторы (ключ, открытый текст, шифротекст), big-endian
+    struct Vector {
+        uint64_t key;
+        uint64_t plain;
+        uint64_t cipher;
+    };
+    const Vector vectors[] = {
+        {0x0000000000000000ULL, 0x0000000000000000ULL, 0x4EF997456198DD78ULL},
+        {0xFFFFFFFFFFFFFFFFULL, 0xFFFFFFFFFFFFFFFFULL, 0x51866FD5B85ECB8AULL},
+        {0x3000000000000000ULL, 0x1000000000000001ULL, 0x7D856F9A613063F2ULL},
+        {0x1111111111111111ULL, 0x1111111111111111ULL, 0x2466DD878B963C9DULL},
+        {0x0123456789ABCDEFULL, 0x1111111111111111ULL, 0x61F9C3802281B096ULL},
+        {0xFEDCBA9876543210ULL, 0x0123456789ABCDEFULL, 0x0ACEAB0FC6A0A28DULL}
+    };
+    auto bytes = [](uint64_t value) {
+        std::vector<uint8_t> out(8);
+        for (int i = 0; i < 8; ++i) out[i] = static_cast<uint8_t>(value >> (56 - 8 * i));
+        return out;
+    };
+    
+    for (const Vector& v : vectors) {
+        Blowfish blowfish;
+        assert(blowfish.setKey(bytes(v.key)));
+        std::vector<uint8_t> block = bytes(v.plain);
+        blowfish.encryptBlocks(block.data(), block.size());
+        assert(block == bytes(v.cipher));
+        blowfish.decryptBlocks(block.data(), block.size());
+        assert(block == bytes(v.plain));
+    }
+    std::cout << "✓ Standard test vectors" << std::endl;
+    
+    // Недопустимая длина ключа не меняет текущий ключ
+    Blowfish blowfish;
+    assert(blowfish.setKey(bytes(0x0123456789ABCDEFULL)));
+    auto before = blowfish.context();
+    assert(!blowfish.setKey(std::vector<uint8_t>()));
+    assert(!blowfish.setKey(std::vector<uint8_t>(57, 1)));
+    assert(blowfish.context() == before);
+    std::cout << "✓ Key length validation" << std::endl;
+}
+
+void testBlowfishKeyCache() {
+    std::cout << "\n=== Testing Blowfish Key Cache ===" << std::endl;
+    
+    BlowfishKeyCache cache(2);
+    std::vector<uint8_t> key_a(16, 0xA1), key_b(16, 0xB2), key_c(16, 0xC3);
+    auto a = cache.get(1, key_a);
+    auto b = cache.get(2, key_b);
+    assert(a && b && a != b);
+    assert(cache.get(1, key_a) == a);          // попадание, 1 - самый свежий
+    auto c = cache.get(3, key_c);              // вытесняет 2
+    assert(cache.size() == 2);
+    assert(cache.find(2) == nullptr);
+    assert(cache.find(1) == a && cache.find(3) == c);
+    assert(cache.hits() == 3 && cache.misses() == 4);
+    std::cout << "✓ LRU eviction and hit counting" << std::endl;
+    
+    // Контекст из кэша дает тот же шифротекст, что и setKey
+    Blowfish direct;
+    direct.setKey(key_a);
+    std::vector<uint8_t> packet(100, 0x33);
+    auto expected = direct.encrypt(packet);
+    
+    // Один контекст на несколько потоков без копирования таблиц
+    std::vector<std::thread> threads;
+    std::vector<int> matches(4, 0);
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t]() {
+            Blowfish shared(cache.get(1, key_a));
+            matches[t] = shared.encrypt(packet) == expected;
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    assert(std::count(matches.begin(), matches.end(), 1) == 4);
+    std::cout << "✓ Shared context across threads" << std::endl;
+}
+
+void testBlowfishInterleavedBlocks() {
+    std::cout << "\n=== Testing Interleaved Blowfish Blocks ===" << std::endl;
+    
+    Blowfish blowfish;
+    blowfish.setKey({0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF});
+    const BlowfishContext& context = *blowfish.context();
+    
+    // Пакеты из 8 блоков, хвосты и их смесь совпадают с поблочным шифрованием
+    for (size_t blocks = 0; blocks <= 21; ++blocks) {
+        std::vector<uint8_t> data(blocks * 8);
+        for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<uint8_t>(i * 31 + blocks);
+        
+        std::vector<uint8_t> expected = data;
+        for (size_t i = 0; i < expected.size(); i += 8) {
+            uint32_t left = (uint32_t(expected[i]) << 24) | (uint32_t(expected[i + 1]) << 16) |
+                            (uint32_t(expected[i + 2]) << 8) | expected[i + 3];
+            uint32_t right = (uint32_t(expected[i + 4]) << 24) | (uint32_t(expected[i + 5]) << 16) |
+                             (uint32_t(expected[i + 6]) << 8) | expected[i + 7];
+            context.encryptBlock(left, right);
+            for (int j = 0; j < 4; ++j) {
+                expected[i + j] = static_cast<uint8_t>(left >> (24 - 8 * j));
+                expected[i + 4 + j] = static_cast<uint8_t>(right >> (24 - 8 * j));
+            }
+        }
+        
+        std::vector<uint8_t> encrypted = data;
+        blowfish.encryptBlocks(encrypted.data(), encrypted.size());
+        assert(encrypted == expected);
+        blowfish.decryptBlocks(encrypted.data(), encrypted.size());
+        assert(encrypted == data);
+    }
+    std::cout << "✓ Interleaved kernels match single-block encryption" << std::endl;
+}
+
+void testBlowfishCTRAndCBC() {
+    std::cout << "\n=== Testing Blowfish CTR and CBC Modes ===" << std::endl;
+    
+    std::vector<uint8_t> key = {0xFE, 0xDC, 0xBA, 0x98, 0x76, 0x54, 0x32, 0x10};
+    Blowfish serial, parallel;
+    serial.setKey(key);
+    serial.setNumThreads(1);
+    parallel.setContext(serial.context());
+    parallel.setNumThreads(4);
+    const uint64_t iv = 0x0123456789ABCDEFULL;
+    
+    // Первый блок гаммы - шифр от самого iv
+    std::vector<uint8_t> zeros(8, 0), keystream(8);
+    serial.ctr(zeros.data(), zeros.size(), keystream.data(), iv);
+    std::vector<uint8_t> iv_block = {0x01, 0x23, 0x45, 0x67, 0x89, 0xAB, 0xCD, 0xEF};
+    serial.encryptBlocks(iv_block.data(), iv_block.size());
+    assert(keystream == iv_block);
+    
+    // Многопоточный CTR совпадает с однопоточным, расшифровка - тот же CTR
+    std::vector<uint8_t> data((1 << 20) + 13);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<uint8_t>(i * 131 + 7);
+    std::vector<uint8_t> expected(data.size()), actual(data.size());
+    serial.ctr(data.data(), data.size(), expected.data(), iv);
+    parallel.ctr(data.data(), data.size(), actual.data(), iv);
+    assert(actual == expected);
+    parallel.ctr(actual.data(), actual.size(), actual.data(), iv);
+    assert(actual == data);
+    
+    // Произвольный доступ: отрезок с невыровненным смещением
+    const size_t offset = 70001, length = 333;
+    std::vector<uint8_t> piece(length);
+    serial.ctr(data.data() + offset, length, piece.data(), iv, offset);
+    assert(std::equal(piece.begin(), piece.end(), expected.begin() + offset));
+    std::cout << "✓ CTR: parallel equals serial, random access" << std::endl;
+    
+    // CBC: первый блок E(P0 ^ IV), параллельная расшифровка на месте и в буфер
+    std::vector<uint8_t> cipher(Blowfish::paddedSize(data.size()));
+    size_t cipher_length = 0, plain_length = 0;
+    assert(serial.encryptCBC(data.data(), data.size(), cipher.data(), cipher.size(),
+                             cipher_length, iv));
+    std::vector<uint8_t> first(data.begin(), data.begin() + 8);
+    for (int i = 0; i < 8; ++i) first[i] ^= static_cast<uint8_t>(iv >> (56 - 8 * i));
+    serial.encryptBlocks(first.data(), first.size());
+    assert(std::equal(first.begin(), first.end(), cipher.begin()));
+    
+    std::vector<uint8_t> plain(cipher_length);
+    assert(parallel.decryptCBC(cipher.data(), cipher_length, plain.data(), plain_length, iv));
+    assert(plain_length == data.size() && std::equal(data.begin(), data.end(), plain.begin()));
+    assert(parallel.decryptCBC(cipher.data(), cipher_length, cipher.data(), plain_length, iv));
+    assert(plain_length == data.size() && std::equal(data.begin(), data.end(), cipher.begin()));
+    
+    for (size_t size : {0, 5, 8, 100}) {
+        std::vector<uint8_t> small(Blowfish::paddedSize(size), 0x5C);
+        assert(serial.encryptCBC(small.data(), size, small.data(), small.size(), cipher_length, iv));
+        assert(serial.decryptCBC(small.data(), cipher_length, small.data(), plain_length, iv));
+        assert(plain_length == size);
+    }
+    std::cout << "✓ CBC: round trips, parallel in-place decryption" << std::endl;
+}
+
+void testBlowfishSimdKernels() {
+    std::cout << "\n=== Testing Blowfish SIMD Kernels ===" << std::endl;
+    
+    Blowfish scalar;
+    scalar.setKey({0x37, 0x52, 0x7A, 0x11, 0xC4, 0x09, 0xEE, 0x5B, 0x90});
+    scalar.setSimdLevel(BlowfishSimd::Scalar);
+    scalar.setNumThreads(1);
+    
+    // Все ядра дают одинаковый результат при любом числе блоков
+    // (полные векторы, хвосты, несколько пакетов по 64 блока)
+    for (BlowfishSimd level : {BlowfishSimd::AVX2, BlowfishSimd::AVX512}) {
+        Blowfish vector(scalar.context());
+        vector.setSimdLevel(level);
+        vector.setNumThreads(1);
+        std::cout << "Kernel: " << vector.simdName() << std::endl;
+        for (size_t blocks : {0, 1, 7, 8, 15, 16, 17, 31, 33, 64, 65, 100, 200}) {
+            std::vector<uint8_t> data(blocks * 8);
+            for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<uint8_t>(i * 13 + 1);
+            std::vector<uint8_t> expected = data, actual = data;
+            scalar.encryptBlocks(expected.data(), expected.size());
+            vector.encryptBlocks(actual.data(), actual.size());
+            assert(actual == expected);
+            vector.decryptBlocks(actual.data(), actual.size());
+            assert(actual == data);
+            
+            scalar.ctr(data.data(), data.size(), expected.data(), 42, 3);
+            vector.ctr(data.data(), data.size(), actual.data(), 42, 3);
+            assert(actual == expected);
+        }
+    }
+    std::cout << "✓ SIMD kernels match scalar" << std::endl;
+}
+
+void testBlowfishPacketBatch() {
+    std::cout << "\n=== Testing Blowfish Packet Batch ===" << std::endl;
+    
+    Blowfish blowfish;
+    blowfish.setKey(std::vector<uint8_t>(16, 0x6B));
+    
+    // Пакеты разной длины, включая пустой и невыровненные
+    std::vector<size_t> sizes = {64, 0, 1, 13, 128, 7, 1500, 256, 40, 9};
+    for (int i = 0; i < 2000; ++i) sizes.push_back(64 + (i * 37) % 200);
+    std::vector<std::vector<uint8_t>> plain(sizes.size()), cipher(sizes.size());
+    std::vector<BlowfishPacket> packets;
+    for (size_t p = 0; p < sizes.size(); ++p) {
+        plain[p].resize(sizes[p]);
+        for (size_t i = 0; i < sizes[p]; ++i) plain[p][i] = static_cast<uint8_t>(i + p);
+        cipher[p].resize(sizes[p]);
+        packets.push_back({plain[p].data(), cipher[p].data(), sizes[p], p * 1000003ULL});
+    }
+    
+    // Совпадает с поштучным CTR, последовательно и в пуле
+    for (size_t threads : {size_t(1), size_t(3)}) {
+        blowfish.setNumThreads(threads);
+        blowfish.ctrPackets(packets);
+        for (size_t p = 0; p < sizes.size(); ++p) {
+            std::vector<uint8_t> expected(sizes[p]);
+            blowfish.ctr(plain[p].data(), sizes[p], expected.data(), packets[p].iv);
+            assert(cipher[p] == expected);
+        }
+    }
+    
+    // Расшифровка на месте тем же вызовом
+    for (size_t p = 0; p < sizes.size(); ++p) {
+        packets[p].in = cipher[p].data();
+    }
+    blowfish.ctrPackets(packets);
+    for (size_t p = 0; p < sizes.size(); ++p) {
+        assert(cipher[p] == plain[p]);
+    }
+    std::cout << "✓ Batched CTR matches per-packet CTR" << std::endl;
+}
+
+void testBlowfishStreaming() {
+    std::cout << "\n=== Testing Blowfish Streaming ===" << std::endl;
+    
+    auto context = BlowfishContext::expand(std::vector<uint8_t>(24, 0x9D));
+    Blowfish blowfish(context);
+    const uint64_t iv = 0xDEADBEEF01234567ULL;
+    
+    std::vector<uint8_t> data(200000);
+    for (size_t i = 0; i < data.size(); ++i) data[i] = static_cast<uint8_t>(i * 7 + (i >> 9));
+    
+    // Куски произвольного размера, в том числе пустые и меньше блока
+    const std::vector<size_t> chunks = {0, 1, 3, 8, 5, 16, 4095, 7, 70000, 2, 9};
+    auto run = [&](auto& stream, const std::vector<uint8_t>& input) {
+        std::vector<uint8_t> output, buffer;
+        size_t pos = 0, c = 0, written = 0;
+        while (pos < input.size()) {
+            size_t n = std::min(chunks[c++ % chunks.size()], input.size() - pos);
+            buffer.resize(stream.updateSize(n));
+            assert(stream.update(input.data() + pos, n, buffer.data(), buffer.size(), written));
+            output.insert(output.end(), buffer.begin(), buffer.begin() + written);
+            pos += n;
+        }
+        buffer.resize(Blowfish::BLOCK_SIZE);
+        assert(stream.finalize(buffer.data(), buffer.size(), written));
+        output.insert(output.end(), buffer.begin(), buffer.begin() + written);
+        return output;
+    };
+    
+    for (size_t size : {size_t(0), size_t(7), size_t(8), size_t(64), data.size()}) {
+        std::vector<uint8_t> input(data.begin(), data.begin() + size);
+        
+        // CBC: совпадает с шифрованием целого сообщения
+        BlowfishEncryptor encryptor(context, BlowfishMode::CBC, iv);
+        std::vector<uint8_t> cipher = run(encryptor, input);
+        std::vector<uint8_t> expected(Blowfish::paddedSize(size));
+        size_t expected_length = 0;
+        assert(blowfish.encryptCBC(input.data(), size, expected.data(), expected.size(),
+                                   expected_length, iv));
+        assert(cipher == expected);
+        BlowfishDecryptor decryptor(context, BlowfishMode::CBC, iv);
+        assert(run(decryptor, cipher) == input);
+        
+        // CTR: совпадает с ctr целого буфера
+        BlowfishEncryptor ctr_encryptor(context, BlowfishMode::CTR, iv);
+        cipher = run(ctr_encryptor, input);
+        expected.resize(size);
+        blowfish.ctr(input.data(), size, expected.data(), iv);
+        assert(cipher == expected);
+        BlowfishDecryptor ctr_decryptor(context, BlowfishMode::CTR, iv);
+        assert(run(ctr_decryptor, cipher) == input);
+    }
+    std::cout << "✓ Chunked CBC/CTR equal one-shot encryption" << std::endl;
+    
+    // Обрезанный шифротекст и повторное использование после reset
+    BlowfishEncryptor encryptor(context, BlowfishMode::CBC, iv);
+    std::vector<uint8_t> cipher = run(encryptor, std::vector<uint8_t>(data.begin(), data.begin() + 30));
+    BlowfishDecryptor decryptor(context, BlowfishMode::CBC, iv);
+    std::vector<uint8_t> buffer(64);
+    size_t written = 0;
+    assert(decryptor.update(cipher.data(), cipher.size() - 3, buffer.data(), buffer.size(), written));
+    assert(!decryptor.finalize(buffer.data(), buffer.size(), written));
+    assert(!decryptor.update(cipher.data(), 8, buffer.data(), buffer.size(), written));
+    decryptor.reset(iv);
+    assert(run(decryptor, cipher) == std::vector<uint8_t>(data.begin(), data.begin() + 30));
+    std::cout << "✓ Truncated input rejected, reset reuses the stream" << std::endl;
+}
+
 void runAllCryptoTests() {
     std::cout << "Running Blowfish Cryptography Tests..." << std::endl;
     
@@ -132,6 +498,14 @@ void runAllCryptoTests() {
         testBlowfishBasic();
         testBlowfishPerformance();
         testBlowfishEdgeCases();
+        testBlowfishBufferAPI();
+        testBlowfishReferenceVectors();
+        testBlowfishKeyCache();
+        testBlowfishInterleavedBlocks();
+        testBlowfishCTRAndCBC();
+        testBlowfishSimdKernels();
+        testBlowfishPacketBatch();
+        testBlowfishStreaming();
         
         std::cout << "\n=========================================" << std::endl;
         std::cout << "All cryptography tests passed successfully!" << std::endl;
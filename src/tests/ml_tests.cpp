@@ -1,7 +1,24 @@
 #include "../ml/knn_classifier.h"
 #include "../ml/data_processor.h"
+#include "../ml/csv_batch_reader.h"
+#include "../ml/dataset_cache.h"
+#include "../ml/feature_scaler.h"
+#include "../ml/cross_validation.h"
+#include "../ml/classification_metrics.h"
+#include "../ml/sliding_window_knn.h"
 #include <iostream>
 #include <vector>
+#include <random>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <cmath>
+#include <iomanip>
+#include <memory>
+#include <algorithm>
+#include <thread>
+#include <atomic>
 
 void testKNN() {
     std::cout << "Testing KNN Classifier..." << std::endl;
@@ -39,4 +56,780 @@ void testKNN() {
     // Тестирование F1-score
     double f1 = knn.calculateF1Score(test_data, test_labels, 3);
     std::cout << "F1-Score: " << f1 << std::endl;
-}
\ No newline at end of file
+}
+
+void testKNNParallelMatchesSerial() {
+    std::cout << "Testing parallel predictBatch..." << std::endl;
+
+    std::mt19937 gen(42);
+    std::uniform_real_distribution<> dist(0.0, 1.0);
+
+    std::vector<std::vector<double>> train_data(2000, std::vector<double>(10));
+    std::vector<std::string> train_labels;
+    for (auto& sample : train_data) {
+        for (auto& value : sample) value = dist(gen);
+        train_labels.push_back(sample[0] + sample[1] > 1.0 ? "Attack" : "Normal");
+    }
+
+    std::vector<std::vector<double>> test_data(500, std::vector<double>(10));
+    for (auto& sample : test_data) {
+        for (auto& value : sample) value = dist(gen);
+    }
+
+    KNNClassifier serial;
+    serial.setNumThreads(1);
+    serial.fit(train_data, train_labels);
+
+    KNNClassifier parallel;
+    parallel.setNumThreads(4);
+    parallel.fit(train_data, train_labels);
+
+    // Порядок и значения предсказаний должны совпадать с последовательными
+    assert(serial.predictBatch(test_data, 5) == parallel.predictBatch(test_data, 5));
+    std::cout << "✓ Parallel predictions match serial ones" << std::endl;
+}
+
+
+void testDistanceKernels() {
+    std::cout << "Testing SIMD distance kernels..." << std::endl;
+
+    std::mt19937 gen(5);
+    std::uniform_real_distribution<> dist(-1.0, 1.0);
+    std::uniform_int_distribution<> byte(0, 255);
+    const DistanceKernels& scalar = distanceKernelsFor(SimdLevel::Scalar);
+    SimdLevel supported = detectSimdLevel();
+
+    // Все уровни, включая неподдерживаемые процессором: они должны
+    // сводиться к доступному уровню, а не падать
+    for (SimdLevel level : {SimdLevel::SSE2, SimdLevel::AVX2, SimdLevel::AVX512}) {
+        const DistanceKernels& kernels = distanceKernelsFor(level);
+        assert(static_cast<int>(kernels.level) <= static_cast<int>(supported));
+        assert(static_cast<int>(kernels.level) <= static_cast<int>(level));
+
+        // Длины не кратны ширине регистра: проверяются хвосты
+        for (size_t n : {1, 3, 5, 7, 9, 13, 17, 23, 31, 33, 41, 67, 100}) {
+            std::vector<double> a(n), b(n);
+            std::vector<float> af(n), bf(n);
+            std::vector<uint8_t> au(n), bu(n);
+            for (size_t j = 0; j < n; ++j) {
+                a[j] = dist(gen);
+                b[j] = dist(gen);
+                af[j] = static_cast<float>(a[j]);
+                bf[j] = static_cast<float>(b[j]);
+                au[j] = static_cast<uint8_t>(byte(gen));
+                bu[j] = static_cast<uint8_t>(byte(gen));
+            }
+            double expected = scalar.squaredL2(a.data(), b.data(), n);
+            assert(std::abs(kernels.squaredL2(a.data(), b.data(), n) - expected) <= 1e-12 * (1.0 + expected));
+            double expected_f32 = scalar.squaredL2F32(af.data(), bf.data(), n);
+            assert(std::abs(kernels.squaredL2F32(af.data(), bf.data(), n) - expected_f32) <=
+                   1e-5 * (1.0 + expected_f32));
+            assert(kernels.squaredL2U8(au.data(), bu.data(), n) == scalar.squaredL2U8(au.data(), bu.data(), n));
+        }
+
+        // Микроядро GEMM: 8 запросов x 24 строки, размерность 11
+        const size_t nq = 8, nr = 24, dim = 11;
+        std::vector<double> queries(nq * dim), columns(dim * nr);
+        for (auto& value : queries) value = dist(gen);
+        for (auto& value : columns) value = dist(gen);
+        std::vector<double> expected(nq * nr), actual(nq * nr);
+        scalar.dotBlock(queries.data(), dim, nq, columns.data(), nr, nr, dim, expected.data(), nr);
+        kernels.dotBlock(queries.data(), dim, nq, columns.data(), nr, nr, dim, actual.data(), nr);
+        for (size_t i = 0; i < expected.size(); ++i) {
+            assert(std::abs(actual[i] - expected[i]) <= 1e-12);
+        }
+        std::cout << "✓ " << kernels.name << " kernels match scalar" << std::endl;
+    }
+}
+
+void testKNNBatchMatchesSinglePredictions() {
+    std::cout << "Testing blocked batch path against predict..." << std::endl;
+
+    // Точки сетки со смещением: много равных расстояний, а погрешность
+    // ||q||^2 + ||x||^2 - 2 q.x велика по сравнению с разницей расстояний
+    std::mt19937 gen(11);
+    std::uniform_int_distribution<> grid(0, 3);
+    std::vector<std::vector<double>> train_data(3000, std::vector<double>(6));
+    std::vector<std::string> train_labels;
+    for (size_t i = 0; i < train_data.size(); ++i) {
+        for (auto& value : train_data[i]) value = 1e5 + grid(gen) * 0.1;
+        train_labels.push_back(std::to_string(i));
+    }
+    std::vector<std::vector<double>> test_data(300, std::vector<double>(6));
+    for (auto& sample : test_data) {
+        for (auto& value : sample) value = 1e5 + grid(gen) * 0.05;
+    }
+
+    for (auto layout : {KNNClassifier::ScanLayout::RowMajor, KNNClassifier::ScanLayout::ColumnMajor}) {
+        KNNClassifier knn;
+        knn.setIndexType(KNNClassifier::IndexType::BruteForce);
+        knn.setScanLayout(layout);
+        knn.fit(train_data, train_labels);
+        for (int k : {1, 7}) {
+            auto batch = knn.predictBatch(test_data, k);
+            for (size_t i = 0; i < test_data.size(); ++i) {
+                assert(batch[i] == knn.predict(test_data[i], k));
+            }
+        }
+    }
+    std::cout << "✓ Blocked batch predictions match per-sample ones, including ties" << std::endl;
+}
+
+void testKNNIndexMatchesBruteForce() {
+    std::cout << "Testing KD-tree and VP-tree indexes..." << std::endl;
+
+    std::mt19937 gen(7);
+    std::uniform_real_distribution<> dist(0.0, 1.0);
+
+    for (int dims : {4, 40}) {
+        std::vector<std::vector<double>> train_data(5000, std::vector<double>(dims));
+        std::vector<std::string> train_labels;
+        for (size_t i = 0; i < train_data.size(); ++i) {
+            for (auto& value : train_data[i]) value = dist(gen);
+            // Уникальная метка на строку: при k=1 сравниваются сами соседи
+            train_labels.push_back(std::to_string(i));
+        }
+
+        std::vector<std::vector<double>> test_data(200, std::vector<double>(dims));
+        for (auto& sample : test_data) {
+            for (auto& value : sample) value = dist(gen);
+        }
+
+        KNNClassifier brute;
+        brute.setIndexType(KNNClassifier::IndexType::BruteForce);
+        brute.fit(train_data, train_labels);
+        auto expected = brute.predictBatch(test_data, 1);
+
+        for (auto type : {KNNClassifier::IndexType::KDTree, KNNClassifier::IndexType::VPTree}) {
+            KNNClassifier indexed;
+            indexed.setIndexType(type);
+            indexed.fit(train_data, train_labels);
+            assert(indexed.predictBatch(test_data, 1) == expected);
+            std::cout << "✓ " << indexed.indexName() << " matches brute force ("
+                      << dims << " features)" << std::endl;
+        }
+    }
+}
+
+void testKNNSaveLoad() {
+    std::cout << "Testing KNN model save/load..." << std::endl;
+
+    std::mt19937 gen(11);
+    std::uniform_real_distribution<> dist(0.0, 1.0);
+
+    std::vector<std::vector<double>> train_data(6000, std::vector<double>(8));
+    std::vector<std::string> train_labels;
+    for (auto& sample : train_data) {
+        for (auto& value : sample) value = dist(gen);
+        train_labels.push_back(sample[0] + sample[1] > 1.0 ? "attack" : "normal");
+    }
+    std::vector<std::vector<double>> test_data(300, std::vector<double>(8));
+    for (auto& sample : test_data) {
+        for (auto& value : sample) value = dist(gen);
+    }
+
+    const std::string path = "knn_model_test.bin";
+    for (auto type : {KNNClassifier::IndexType::BruteForce, KNNClassifier::IndexType::KDTree,
+                      KNNClassifier::IndexType::HNSW}) {
+        KNNClassifier original;
+        original.setIndexType(type);
+        original.fit(train_data, train_labels);
+        auto expected = original.predictBatch(test_data, 5);
+        assert(original.save(path));
+
+        KNNClassifier restored;
+        assert(restored.load(path));
+        assert(restored.trainingSize() == original.trainingSize());
+        assert(restored.predictBatch(test_data, 5) == expected);
+        // Сохранение поверх файла, из которого модель отображена
+        assert(restored.save(path));
+        assert(restored.predictBatch(test_data, 5) == expected);
+        std::cout << "✓ " << restored.indexName() << " model restored" << std::endl;
+
+        if (type != KNNClassifier::IndexType::BruteForce) {
+            // Порча файла: номер строки в последнем массиве индекса, затем
+            // тип индекса в метаданных. Отвергнутый файл не меняет модель.
+            auto patch = [&path](size_t section, size_t offset, uint32_t value) {
+                std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+                uint32_t count = 0;
+                file.seekg(12);
+                file.read(reinterpret_cast<char*>(&count), sizeof(count));
+                uint64_t start = 0;
+                file.seekg(64 + (section == SIZE_MAX ? count - 1 : section) * 24 + 8);
+                file.read(reinterpret_cast<char*>(&start), sizeof(start));
+                file.seekp(start + offset);
+                file.write(reinterpret_cast<const char*>(&value), sizeof(value));
+            };
+            patch(SIZE_MAX, 0, 0xFFFFFFF0u);
+            assert(!restored.load(path));
+            assert(original.save(path));
+            patch(0, 44, 99);
+            assert(!restored.load(path));
+            assert(restored.predictBatch(test_data, 5) == expected);
+            std::cout << "✓ corrupted " << restored.indexName() << " model rejected" << std::endl;
+        }
+    }
+
+    KNNClassifier reduced;
+    reduced.setPrecision(KNNClassifier::Precision::UInt8);
+    reduced.fit(train_data, train_labels);
+    auto expected = reduced.predictBatch(test_data, 5);
+    assert(reduced.save(path));
+    KNNClassifier restored;
+    assert(restored.load(path));
+    assert(restored.predictBatch(test_data, 5) == expected);
+    std::cout << "✓ uint8 model restored" << std::endl;
+
+    std::remove(path.c_str());
+}
+
+void testKNNReducedPrecision() {
+    std::cout << "Testing reduced-precision storage..." << std::endl;
+
+    std::mt19937 gen(21);
+    std::uniform_real_distribution<> dist(0.0, 1.0);
+    std::vector<std::vector<double>> train_data(3000, std::vector<double>(12));
+    std::vector<std::string> train_labels;
+    for (auto& sample : train_data) {
+        for (auto& value : sample) value = dist(gen);
+        train_labels.push_back(sample[0] + sample[1] > 1.0 ? "attack" : "normal");
+    }
+    std::vector<std::vector<double>> test_data(400, std::vector<double>(12));
+    for (auto& sample : test_data) {
+        for (auto& value : sample) value = dist(gen);
+    }
+
+    KNNClassifier exact;
+    exact.fit(train_data, train_labels);
+    auto expected = exact.predictBatch(test_data, 5);
+
+    // float32 почти не меняет расстояния; uint8 - в пределах шага квантования
+    for (auto p : {KNNClassifier::Precision::Float32, KNNClassifier::Precision::UInt8}) {
+        KNNClassifier reduced;
+        reduced.setPrecision(p);
+        reduced.fit(train_data, train_labels);
+        assert(reduced.storagePrecision() == p);
+        assert(reduced.memoryFootprint() < exact.memoryFootprint());
+
+        auto predicted = reduced.predictBatch(test_data, 5);
+        size_t agree = 0;
+        for (size_t i = 0; i < test_data.size(); ++i) agree += predicted[i] == expected[i];
+        double tolerance = p == KNNClassifier::Precision::Float32 ? 1e-5 : 0.05;
+        assert(agree >= test_data.size() * (p == KNNClassifier::Precision::Float32 ? 0.99 : 0.9));
+
+        for (size_t i = 0; i < 50; ++i) {
+            auto nearest = exact.findNeighbours(test_data[i], 1);
+            auto approx = reduced.findNeighbours(test_data[i], 1);
+            assert(approx.size() == 1);
+            double d = 0.0;
+            for (size_t j = 0; j < 12; ++j) {
+                double diff = train_data[approx[0].index][j] - test_data[i][j];
+                d += diff * diff;
+            }
+            // Выбранный сосед почти так же близок, как настоящий ближайший
+            assert(d <= nearest[0].distance + tolerance * 12);
+            assert(std::abs(approx[0].distance - d) <= tolerance * 12);
+        }
+        std::cout << "✓ " << (p == KNNClassifier::Precision::Float32 ? "float32" : "uint8")
+                  << " agrees with float64 on " << agree << "/" << test_data.size() << std::endl;
+    }
+
+    // Смена точности после fit относится к следующему fit: модель продолжает
+    // работать в формате, в котором обучена
+    const std::string path = "knn_precision_test.bin";
+    KNNClassifier model;
+    model.setPrecision(KNNClassifier::Precision::Float32);
+    model.fit(train_data, train_labels);
+    auto stored = model.predictBatch(test_data, 5);
+    for (auto p : {KNNClassifier::Precision::UInt8, KNNClassifier::Precision::Float64}) {
+        model.setPrecision(p);
+        assert(model.storagePrecision() == KNNClassifier::Precision::Float32);
+        assert(model.predict(test_data[0], 5) == stored[0]);
+        assert(model.predictBatch(test_data, 5) == stored);
+        assert(model.save(path));
+        KNNClassifier restored;
+        assert(restored.load(path));
+        assert(restored.storagePrecision() == KNNClassifier::Precision::Float32);
+        assert(restored.predictBatch(test_data, 5) == stored);
+    }
+    std::remove(path.c_str());
+    std::cout << "✓ setPrecision after fit keeps the stored format" << std::endl;
+}
+
+void testCSVLoader() {
+    std::cout << "Testing CSV loader..." << std::endl;
+
+    const std::string path = "csv_loader_test.csv";
+    {
+        std::ofstream out(path);
+        out << "duration,bytes,flag,label\r\n";
+        out << "1.5,200, 3,normal\r\n";
+        out << "\r\n";
+        out << "+2,abc,1e3,attack\n";
+        out << "0.25,7,-4,normal\n";
+        out << "9,8\n";  // неполная строка: недостающие признаки равны 0
+    }
+
+    DataProcessor processor;
+    for (size_t threads : {1, 4}) {
+        DataProcessor::FeatureTable table = processor.loadCSVTable(path, threads);
+        assert(table.feature_names.size() == 3);
+        assert(table.features.rows() == 4);
+        assert(table.features.at(0, 2) == 3.0);
+        assert(table.features.at(1, 0) == 2.0);
+        assert(table.features.at(1, 1) == 0.0);
+        assert(table.features.at(1, 2) == 1000.0);
+        assert(table.features.at(3, 1) == 0.0);
+        assert(table.label_names.size() == 3 && table.label_names[0] == "normal");
+        assert(table.label_ids[2] == 0 && table.label_ids[1] == 1);
+    }
+
+    DataProcessor::NetworkTrafficData data = processor.loadFromCSV(path);
+    assert(data.features.size() == 4 && data.labels[1] == "attack");
+    assert(data.label_encoding["attack"] == 1);
+    std::cout << "✓ CSV loader parses rows, labels and malformed cells" << std::endl;
+
+    std::remove(path.c_str());
+    std::remove((path + ".cols").c_str());
+}
+
+void testStreamingEvaluation() {
+    std::cout << "Testing streaming evaluation..." << std::endl;
+
+    std::mt19937 gen(5);
+    std::uniform_real_distribution<> dist(0.0, 1.0);
+    std::vector<std::vector<double>> train_data(2000, std::vector<double>(6));
+    std::vector<std::string> train_labels;
+    for (auto& sample : train_data) {
+        for (auto& value : sample) value = dist(gen);
+        train_labels.push_back(sample[0] > 0.6 ? "dos" : (sample[1] > 0.5 ? "probe" : "normal"));
+    }
+
+    // Тестовый файл, в том числе с меткой, которой нет в обучающей выборке
+    const std::string path = "stream_test.csv";
+    std::vector<std::vector<double>> test_data(1001, std::vector<double>(6));
+    std::vector<std::string> test_labels;
+    {
+        std::ofstream out(path);
+        out << "f0,f1,f2,f3,f4,f5,label\n";
+        for (size_t i = 0; i < test_data.size(); ++i) {
+            for (auto& value : test_data[i]) {
+                value = std::round(dist(gen) * 1000.0) / 1000.0;
+                out << value << ",";
+            }
+            test_labels.push_back(i % 97 == 0 ? "r2l" : test_data[i][0] > 0.6 ? "dos" : "normal");
+            out << test_labels.back() << "\n";
+        }
+    }
+
+    KNNClassifier knn;
+    knn.setBatchThreshold(0);
+    knn.fit(train_data, train_labels);
+    double expected = knn.calculateF1Score(test_data, test_labels, 5);
+
+    // Маленький буфер заставляет переносить строки между чтениями
+    CSVBatchReader reader(path, 64, 256);
+    assert(reader.isOpen() && reader.featureNames().size() == 6);
+    double streamed = knn.calculateF1Score(reader, 5);
+    assert(reader.rowsRead() == test_data.size());
+    assert(std::abs(streamed - expected) < 1e-12);
+
+    CSVBatchReader batches(path, 100);
+    DataProcessor::FeatureTable batch;
+    size_t offset = 0;
+    while (batches.next(batch)) {
+        auto predictions = knn.predictBatch(batch.features, 5);
+        for (size_t i = 0; i < predictions.size(); ++i) {
+            assert(predictions[i] == knn.predict(test_data[offset + i], 5));
+        }
+        offset += predictions.size();
+    }
+    assert(offset == test_data.size());
+    std::cout << "✓ Streaming F1 matches in-memory F1: " << streamed << std::endl;
+
+    std::remove(path.c_str());
+}
+
+void testDatasetCache() {
+    std::cout << "Testing columnar dataset cache..." << std::endl;
+
+    const std::string path = "dataset_cache_test.csv";
+    const std::string cache_path = path + ".cols";
+    std::remove(cache_path.c_str());
+    {
+        std::ofstream out(path);
+        out << "protocol,count,rate,bytes,label\n";
+        std::mt19937 gen(3);
+        for (int i = 0; i < 5000; ++i) {
+            out << gen() % 3 << "," << static_cast<int>(gen() % 100000) - 50000 << ","
+                << (gen() % 100) / 4.0 << "," << (gen() % 100000) / 7.0 << ","
+                << (i % 3 == 0 ? "normal" : "smurf") << "\n";
+        }
+    }
+
+    DataProcessor processor;
+    DataProcessor::FeatureTable parsed = processor.loadDataset(path);
+    auto cached = ColumnarDataset::open(cache_path);
+    assert(cached && cached->rows() == 5000 && cached->cols() == 4);
+    assert(cached->columnType(0) == ColumnarDataset::ColumnType::UInt8);
+    assert(cached->columnType(1) == ColumnarDataset::ColumnType::Int32);
+    assert(cached->columnType(2) == ColumnarDataset::ColumnType::Float32);
+    assert(cached->columnType(3) == ColumnarDataset::ColumnType::Float64);
+    assert(cached->featureName(3) == "bytes");
+
+    DataProcessor::FeatureTable reopened = processor.loadDataset(path);
+    assert(reopened.features.rows() == parsed.features.rows());
+    assert(reopened.label_ids == parsed.label_ids && reopened.label_names == parsed.label_names);
+    for (size_t i = 0; i < parsed.features.rows(); ++i) {
+        for (size_t j = 0; j < parsed.features.cols(); ++j) {
+            assert(reopened.features.at(i, j) == parsed.features.at(i, j));
+        }
+    }
+    assert(reopened.ranges.mins == parsed.ranges.mins && reopened.ranges.maxs == parsed.ranges.maxs);
+    std::cout << "✓ Cache reopens with identical values and column ranges" << std::endl;
+
+    // Нормализация по сохраненным диапазонам совпадает с обычной
+    DataProcessor::NetworkTrafficData data = processor.loadFromCSV(path);
+    std::vector<std::vector<double>> reference = data.features;
+    DataProcessor::NormalizationParams expected, actual;
+    processor.normalizeFeatures(reference, expected);
+    processor.normalizeFeatures(data, actual);
+    assert(actual.mins == expected.mins && actual.maxs == expected.maxs);
+    assert(data.features == reference);
+    std::cout << "✓ normalizeFeatures uses stored ranges" << std::endl;
+
+    // Перезапись кэша не трогает уже отображенный старый файл
+    DataProcessor::FeatureTable half;
+    half.features = FeatureMatrix(10, parsed.features.cols());
+    for (size_t i = 0; i < 10; ++i) {
+        for (size_t j = 0; j < half.features.cols(); ++j) half.features.at(i, j) = i * 0.1 + j;
+    }
+    half.label_ids.assign(10, 0);
+    half.label_names = {"normal"};
+    assert(ColumnarDataset::write(cache_path, half, 0, 0));
+    DataProcessor::FeatureTable old_table = cached->toTable(1);
+    assert(old_table.label_ids == parsed.label_ids);
+    assert(old_table.features.at(4999, 3) == parsed.features.at(4999, 3));
+    auto rewritten = ColumnarDataset::open(cache_path);
+    assert(rewritten && rewritten->rows() == 10);
+
+    // Огромное число строк в заголовке: без проверки n_rows * 4 и n_rows * 8
+    // переполняются до размеров настоящих секций
+    {
+        std::fstream file(cache_path, std::ios::in | std::ios::out | std::ios::binary);
+        uint64_t n_rows = (1ULL << 62) + 10;
+        file.seekp(16);
+        file.write(reinterpret_cast<const char*>(&n_rows), sizeof(n_rows));
+    }
+    assert(!ColumnarDataset::open(cache_path));
+    std::cout << "✓ Cache is replaced atomically and corrupt headers are rejected" << std::endl;
+
+    std::remove(path.c_str());
+    std::remove(cache_path.c_str());
+}
+
+void testFeatureScaler() {
+    std::cout << "Testing feature scaler..." << std::endl;
+
+    std::mt19937 gen(17);
+    std::normal_distribution<> dist(50.0, 12.0);
+    std::vector<std::vector<double>> rows(10000, std::vector<double>(5));
+    for (auto& row : rows) {
+        for (auto& value : row) value = dist(gen);
+        row[4] = 3.0;  // постоянный признак
+    }
+    FeatureMatrix matrix = FeatureMatrix::fromRows(rows);
+
+    FeatureScaler serial(FeatureScaler::Method::ZScore);
+    serial.setNumThreads(1);
+    serial.fit(matrix);
+    FeatureScaler parallel(FeatureScaler::Method::ZScore);
+    parallel.setNumThreads(4);
+    parallel.fit(rows);
+    assert(serial.featureMeans() == parallel.featureMeans());
+    assert(serial.featureStddevs() == parallel.featureStddevs());
+
+    parallel.transform(matrix);
+    for (size_t j = 0; j < 4; ++j) {
+        double sum = 0.0, sum_sq = 0.0;
+        for (size_t i = 0; i < matrix.rows(); ++i) {
+            sum += matrix.at(i, j);
+            sum_sq += matrix.at(i, j) * matrix.at(i, j);
+        }
+        double mean = sum / matrix.rows();
+        assert(std::abs(mean) < 1e-9);
+        assert(std::abs(sum_sq / matrix.rows() - mean * mean - 1.0) < 1e-9);
+    }
+    assert(matrix.at(0, 4) == 0.0 && matrix.row(0)[5] == 0.0);  // хвост строки не тронут
+    std::cout << "✓ z-score: serial and parallel statistics agree" << std::endl;
+
+    // Параметры обучающей выборки применяются к новым данным
+    FeatureScaler minmax;
+    minmax.fit(rows);
+    std::vector<std::vector<double>> live = {{minmax.ranges().maxs[0], 0, 0, 0, 3.0}};
+    minmax.transform(live);
+    assert(std::abs(live[0][0] - 1.0) < 1e-12 && live[0][4] == 0.0);
+
+    // Масштабирование при разборе CSV совпадает с отдельным проходом
+    const std::string path = "scaler_test.csv";
+    {
+        std::ofstream out(path);
+        out << "a,b,c,d,e,label\n";
+        out << std::setprecision(17);
+        for (size_t i = 0; i < 2000; ++i) {
+            for (double value : rows[i]) out << value << ",";
+            out << "normal\n";
+        }
+    }
+    DataProcessor processor;
+    DataProcessor::FeatureTable fused = processor.loadCSVTable(path, 0, &minmax);
+    DataProcessor::FeatureTable plain = processor.loadCSVTable(path);
+    minmax.transform(plain.features);
+    for (size_t i = 0; i < plain.features.rows(); ++i) {
+        for (size_t j = 0; j < 5; ++j) {
+            assert(fused.features.at(i, j) == plain.features.at(i, j));
+        }
+    }
+    std::cout << "✓ min-max fused with CSV parsing matches separate transform" << std::endl;
+
+    std::remove(path.c_str());
+}
+
+void testDatasetViews() {
+    std::cout << "Testing dataset views and splits..." << std::endl;
+
+    std::mt19937 gen(23);
+    std::uniform_real_distribution<> dist(0.0, 1.0);
+    auto table = std::make_shared<DataProcessor::FeatureTable>();
+    table->features = FeatureMatrix(3000, 4);
+    table->label_names = {"normal", "dos", "u2r"};
+    for (size_t i = 0; i < table->features.rows(); ++i) {
+        for (size_t j = 0; j < 4; ++j) table->features.at(i, j) = dist(gen);
+        double x = table->features.at(i, 0);
+        table->label_ids.push_back(x < 0.7 ? 0 : (x < 0.97 ? 1 : 2));
+    }
+
+    DataProcessor processor;
+    DataProcessor::DatasetView train, test, train_again, test_again;
+    processor.splitTable(table, 0.8, 42, true, train, test);
+    processor.splitTable(table, 0.8, 42, true, train_again, test_again);
+    assert(train.rows == train_again.rows && test.rows == test_again.rows);
+    assert(train.size() + test.size() == table->features.rows());
+    assert(train.features(0) == table->features.row(train.rows[0]));  // без копирования
+
+    // Доля каждой метки в test совпадает с долей во всей таблице
+    std::vector<size_t> total(3, 0), in_test(3, 0);
+    for (int32_t label : table->label_ids) total[label]++;
+    for (size_t i = 0; i < test.size(); ++i) in_test[test.labelId(i)]++;
+    for (size_t c = 0; c < 3; ++c) {
+        assert(std::abs(static_cast<double>(in_test[c]) - total[c] * 0.2) <= 1.0);
+    }
+    std::cout << "✓ Stratified split is reproducible and shares storage" << std::endl;
+
+    auto folds = processor.kFoldViews(table, 5, 7);
+    std::vector<int> seen(table->features.rows(), 0);
+    for (const auto& fold : folds) {
+        assert(fold.train.size() + fold.test.size() == table->features.rows());
+        for (uint32_t row : fold.test.rows) seen[row]++;
+    }
+    assert(std::all_of(seen.begin(), seen.end(), [](int count) { return count == 1; }));
+    std::cout << "✓ k-fold views cover every row exactly once" << std::endl;
+
+    // Обучение и оценка по представлениям совпадают с копиями строк
+    std::vector<std::vector<double>> train_rows, test_rows;
+    std::vector<std::string> train_labels, test_labels;
+    for (size_t i = 0; i < train.size(); ++i) {
+        train_rows.emplace_back(train.features(i), train.features(i) + 4);
+        train_labels.push_back(train.label(i));
+    }
+    for (size_t i = 0; i < test.size(); ++i) {
+        test_rows.emplace_back(test.features(i), test.features(i) + 4);
+        test_labels.push_back(test.label(i));
+    }
+    KNNClassifier from_view, from_copy;
+    from_view.fit(train);
+    from_copy.fit(train_rows, train_labels);
+    assert(from_view.calculateF1Score(test, 5) == from_copy.calculateF1Score(test_rows, test_labels, 5));
+    std::cout << "✓ Training on views matches training on copied rows" << std::endl;
+}
+
+void testCrossValidationSweep() {
+    std::cout << "Testing cross-validation k-sweep..." << std::endl;
+
+    std::mt19937 gen(31);
+    std::normal_distribution<> noise(0.0, 0.3);
+    auto table = std::make_shared<DataProcessor::FeatureTable>();
+    table->features = FeatureMatrix(1500, 5);
+    table->label_names = {"normal", "dos", "probe"};
+    for (size_t i = 0; i < table->features.rows(); ++i) {
+        int32_t label = static_cast<int32_t>(gen() % 3);
+        for (size_t j = 0; j < 5; ++j) table->features.at(i, j) = label * 0.4 + noise(gen);
+        table->label_ids.push_back(label);
+    }
+
+    const std::vector<size_t> ks = {1, 3, 5, 9, 15};
+    CrossValidator validator;
+    validator.setFolds(4);
+    validator.setSeed(9);
+    auto results = validator.run(table, ks, {CrossValidator::Metric::Euclidean,
+                                             CrossValidator::Metric::Manhattan});
+    assert(results.size() == ks.size() * 2);
+
+    // Каждое k совпадает с отдельной оценкой классификатора на тех же блоках
+    DataProcessor processor;
+    auto folds = processor.kFoldViews(table, 4, 9);
+    for (size_t ki = 0; ki < ks.size(); ++ki) {
+        for (size_t f = 0; f < folds.size(); ++f) {
+            KNNClassifier knn;
+            knn.setBatchThreshold(0);
+            knn.fit(folds[f].train);
+            double f1 = knn.calculateF1Score(folds[f].test, static_cast<int>(ks[ki]));
+            assert(std::abs(results[ki].fold_f1[f] - f1) < 1e-12);
+        }
+    }
+    const CrossValidator::Result* best = CrossValidator::best(results);
+    assert(best != nullptr);
+    std::cout << "✓ Sweep matches per-k evaluation; best k = " << best->k << " ("
+              << CrossValidator::metricName(best->metric) << ", F1 " << best->mean_f1 << ")"
+              << std::endl;
+}
+
+void testConfusionMatrixMetrics() {
+    std::cout << "Testing confusion matrix metrics..." << std::endl;
+
+    // Фактические и предсказанные номера классов
+    const std::vector<int> actual    = {0, 0, 0, 0, 1, 1, 2, 2, 2, -1};
+    const std::vector<int> predicted = {0, 0, 1, 0, 1, 0, 2, 2, 1, 2};
+    ConfusionMatrix matrix(3);
+    for (size_t i = 0; i < actual.size(); ++i) matrix.add(actual[i], predicted[i]);
+
+    auto stats = matrix.classStats(0);
+    assert(stats.true_positives == 3 && stats.support == 4 && stats.predicted == 4);
+    assert(std::abs(matrix.classStats(2).precision - 2.0 / 3.0) < 1e-12);  // -1 -> ложное срабатывание
+    assert(std::abs(matrix.accuracy() - 0.6) < 1e-12);
+    double f1_0 = 0.75, f1_1 = 0.4, f1_2 = 2.0 / 3.0;
+    assert(std::abs(matrix.macroF1() - (f1_0 + f1_1 + f1_2) / 3.0) < 1e-12);
+    assert(std::abs(matrix.weightedF1() - (f1_0 * 4 + f1_1 * 2 + f1_2 * 3) / 9.0) < 1e-12);
+
+    ConfusionMatrix first(3), second(3);
+    for (size_t i = 0; i < actual.size(); ++i) (i % 2 ? first : second).add(actual[i], predicted[i]);
+    first.merge(second);
+    assert(first.macroF1() == matrix.macroF1() && first.totalCount() == 10);
+    std::cout << "✓ Per-class, macro and weighted metrics" << std::endl;
+
+    // evaluate по номерам label_encoding совпадает со строковой оценкой
+    std::mt19937 gen(13);
+    std::uniform_real_distribution<> dist(0.0, 1.0);
+    DataProcessor::NetworkTrafficData data;
+    data.label_encoding = {{"normal", 0}, {"dos", 1}, {"probe", 2}};
+    for (int i = 0; i < 3000; ++i) {
+        std::vector<double> sample = {dist(gen), dist(gen), dist(gen)};
+        int code = sample[0] < 0.5 ? 0 : (sample[1] < 0.7 ? 1 : 2);
+        data.features.push_back(sample);
+        data.labels.push_back(code == 0 ? "normal" : (code == 1 ? "dos" : "probe"));
+        data.label_ids.push_back(code);
+    }
+    DataProcessor processor;
+    DataProcessor::NetworkTrafficData train, test;
+    processor.splitData(data, 0.7, train, test, 1);
+
+    KNNClassifier knn;
+    knn.fit(train);
+    assert(knn.classNames()[1] == "dos");
+    ConfusionMatrix result = knn.evaluate(test, 5);
+    assert(result.totalCount() == test.features.size());
+    assert(std::abs(result.macroF1() - knn.calculateF1Score(test.features, test.labels, 5)) < 1e-12);
+    result.print(std::cout, knn.classNames());
+    std::cout << "✓ Integer-id evaluation matches string labels" << std::endl;
+
+    // Номер вне словаря или метка без кода: метки кодируются заново по строкам
+    DataProcessor::NetworkTrafficData broken = train;
+    broken.label_ids[0] = 7;
+    KNNClassifier refit;
+    refit.fit(broken);
+    assert(refit.classNames().size() == 3 && refit.classNames()[0] == broken.labels[0]);
+    assert(refit.predictBatch(test.features, 5) == knn.predictBatch(test.features, 5));
+
+    broken = train;
+    broken.label_ids.clear();
+    broken.labels[0] = "u2r";
+    refit.fit(broken);
+    assert(refit.classNames().size() == 4 && refit.classNames()[0] == "u2r");
+    std::cout << "✓ Inconsistent label ids fall back to string labels" << std::endl;
+}
+
+void testSlidingWindowKNN() {
+    std::cout << "Testing sliding-window KNN..." << std::endl;
+
+    std::mt19937 gen(21);
+    std::uniform_real_distribution<> dist(0.0, 1.0);
+    std::vector<std::vector<double>> rows;
+    std::vector<std::string> labels;
+    for (int i = 0; i < 2000; ++i) {
+        std::vector<double> sample = {dist(gen), dist(gen), dist(gen), dist(gen)};
+        // Дрейф: граница классов смещается со временем
+        double boundary = i < 1000 ? 0.3 : 0.7;
+        rows.push_back(sample);
+        labels.push_back(sample[0] < boundary ? "normal" : "attack");
+    }
+
+    // Окно по числу строк совпадает с моделью, обученной на последних строках
+    SlidingWindowKNN window(4, 500, 128);
+    for (size_t i = 0; i < rows.size(); i += 100) {
+        std::vector<std::vector<double>> batch(rows.begin() + i, rows.begin() + i + 100);
+        std::vector<std::string> batch_labels(labels.begin() + i, labels.begin() + i + 100);
+        window.partialFit(batch, batch_labels, static_cast<int64_t>(i / 100));
+    }
+    assert(window.size() == 500 && window.epoch() == 20);
+
+    KNNClassifier reference;
+    reference.setIndexType(KNNClassifier::IndexType::BruteForce);
+    reference.setBatchThreshold(0);
+    reference.fit(std::vector<std::vector<double>>(rows.end() - 500, rows.end()),
+                  std::vector<std::string>(labels.end() - 500, labels.end()));
+    std::vector<std::vector<double>> queries;
+    for (int i = 0; i < 300; ++i) queries.push_back({dist(gen), dist(gen), dist(gen), dist(gen)});
+    auto predicted = window.predictBatch(queries, 5);
+    for (size_t i = 0; i < queries.size(); ++i) {
+        assert(predicted[i] == reference.predict(queries[i], 5));
+        assert(window.predict(queries[i], 5) == predicted[i]);
+    }
+    std::cout << "✓ Count window matches refit on the last rows" << std::endl;
+
+    // Окно по времени и явное вытеснение
+    SlidingWindowKNN timed(4, 0, 64);
+    timed.setMaxAge(3);
+    for (int t = 0; t < 10; ++t) {
+        timed.partialFit({rows[t]}, {labels[t]}, t);
+    }
+    assert(timed.size() == 4);   // отметки 6..9
+    timed.evictOlderThan(8);
+    assert(timed.size() == 2);
+    timed.evict(5);
+    assert(timed.size() == 0 && timed.predict(rows[0], 3).empty());
+    timed.partialFit({rows[0]}, {labels[0]}, 20);
+    assert(timed.predict(rows[0], 3) == labels[0]);
+    std::cout << "✓ Time window and eviction" << std::endl;
+
+    // Предсказания на снимках во время обновлений
+    SlidingWindowKNN shared(4, 256, 32);
+    shared.partialFit({rows[0]}, {labels[0]}, 0);
+    std::atomic<bool> done(false);
+    std::thread reader([&]() {
+        uint64_t last_epoch = 0;
+        while (!done.load()) {
+            uint64_t epoch = shared.epoch();
+            assert(epoch >= last_epoch);
+            last_epoch = epoch;
+            std::string label = shared.predict(queries[epoch % queries.size()], 7);
+            assert(label == "normal" || label == "attack");
+        }
+    });
+    for (size_t i = 1; i < rows.size(); ++i) {
+        shared.partialFit({rows[i]}, {labels[i]}, static_cast<int64_t>(i));
+    }
+    done = true;
+    reader.join();
+    assert(shared.size() == 256);
+    std::cout << "✓ Concurrent predict during partialFit" << std::endl;
+}